@@ -0,0 +1,190 @@
+#ifndef LIBTRADE_BENCH_H
+#define LIBTRADE_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace trade
+{
+namespace bench
+{
+//where the consumer runs relative to the (first) producer
+enum Placement
+{
+    Unpinned = 0,
+    SameCore = 1,
+    SmtSibling = 2,
+    CrossSocket = 3
+};
+
+inline int ReadTopology ( int cpu, const char* entry )
+{
+    std::ifstream in ( "/sys/devices/system/cpu/cpu" + std::to_string ( cpu ) + "/topology/" + entry );
+    int value = -1;
+    in >> value;
+    return value;
+}
+
+//cpu pair (producer, consumer) for a placement, false if the machine has no such pair
+inline bool ResolvePlacement ( int placement, int& producer, int& consumer )
+{
+    int cpus = static_cast<int> ( std::thread::hardware_concurrency() );
+    producer = 0;
+    consumer = -1;
+    switch ( placement )
+    {
+    case Unpinned:
+        producer = -1;
+        return true;
+    case SameCore:
+        consumer = 0;
+        return true;
+    case SmtSibling:
+        for ( int cpu = 1; cpu < cpus; cpu++ )
+        {
+            if ( ReadTopology ( cpu, "core_id" ) == ReadTopology ( 0, "core_id" )
+                    && ReadTopology ( cpu, "physical_package_id" ) == ReadTopology ( 0, "physical_package_id" ) )
+            {
+                consumer = cpu;
+                return true;
+            }
+        }
+        return false;
+    case CrossSocket:
+        for ( int cpu = 1; cpu < cpus; cpu++ )
+        {
+            if ( ReadTopology ( cpu, "physical_package_id" ) != ReadTopology ( 0, "physical_package_id" ) )
+            {
+                consumer = cpu;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+inline void PinThread ( int cpu )
+{
+#if defined(__linux__)
+    if ( cpu < 0 )
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO ( &set );
+    CPU_SET ( cpu, &set );
+    pthread_setaffinity_np ( pthread_self(), sizeof ( set ), &set );
+#else
+    ( void ) cpu;
+#endif
+}
+
+//pins the calling thread for the lifetime of the object and gives it back its previous affinity afterwards,
+//so that a benchmark pinning google benchmark's own thread does not leave every later one on that cpu
+class ScopedPin
+{
+public:
+    explicit ScopedPin ( int cpu )
+    {
+#if defined(__linux__)
+        pinned = cpu >= 0 && pthread_getaffinity_np ( pthread_self(), sizeof ( previous ), &previous ) == 0;
+#endif
+        PinThread ( cpu );
+    }
+
+    ~ScopedPin()
+    {
+#if defined(__linux__)
+        if ( pinned )
+        {
+            pthread_setaffinity_np ( pthread_self(), sizeof ( previous ), &previous );
+        }
+#endif
+    }
+
+private:
+    ScopedPin ( const ScopedPin& );
+    ScopedPin& operator= ( const ScopedPin& ); // non-copyable
+
+#if defined(__linux__)
+    cpu_set_t previous;
+    bool pinned = false;
+#endif
+};
+
+inline int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (
+               std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//element of S bytes whose first 8 bytes carry the enqueue timestamp
+template<int S>
+struct Payload
+{
+    int64_t stamp;
+    char data[S - sizeof ( int64_t )];
+};
+
+template<>
+struct Payload<8>
+{
+    int64_t stamp;
+};
+
+//collects hand-off latencies and reports them as p50/p99/p99.9 counters. room for capacity samples is
+//allocated and touched up front and recording stops once it is full, so the timed loop never allocates
+class LatencyRecorder
+{
+public:
+    explicit LatencyRecorder ( size_t capacity ) : samples ( capacity )
+    {
+    }
+
+    inline void Record ( int64_t nanoseconds )
+    {
+        if ( count < samples.size() )
+        {
+            samples[count++] = nanoseconds;
+        }
+    }
+
+    void Report ( benchmark::State& state )
+    {
+        if ( count == 0 )
+        {
+            return;
+        }
+        std::sort ( samples.begin(), samples.begin() + count );
+        state.counters["p50_ns"] = Percentile ( 0.5 );
+        state.counters["p99_ns"] = Percentile ( 0.99 );
+        state.counters["p99.9_ns"] = Percentile ( 0.999 );
+    }
+
+private:
+    inline double Percentile ( double p ) const
+    {
+        size_t index = std::min ( count - 1, static_cast<size_t> ( p * count ) );
+        return static_cast<double> ( samples[index] );
+    }
+
+    std::vector<int64_t> samples;
+    size_t count = 0;
+};
+}
+}
+
+#endif //LIBTRADE_BENCH_H
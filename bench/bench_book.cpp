@@ -0,0 +1,61 @@
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "../book.h"
+
+using namespace trade::book;
+
+namespace
+{
+constexpr int RestingOrders = 20000;
+
+//update stream of a liquid contract: adds and cancels within a few ticks of the top, the book holding
+//around RestingOrders orders. one item is one book update
+void BM_BookUpdate ( benchmark::State& state )
+{
+    std::mt19937_64 rng ( 42 );
+    std::vector<uint64_t> stream ( 1 << 20 );
+    for ( auto& x : stream )
+    {
+        x = rng();
+    }
+    OrderBook book ( 1 << 16 );
+    OrderId next = 1;
+    size_t i = 0;
+    for ( auto _ : state )
+    {
+        uint64_t x = stream[i++ & ( stream.size() - 1 )];
+        if ( book.Size() < RestingOrders || ( x & 1 ) )
+        {
+            bool bid = ( x >> 1 ) & 1;
+            Price offset = static_cast<Price> ( ( x >> 8 ) % state.range ( 0 ) );
+            book.Add ( next++, bid ? Side::Bid : Side::Ask, bid ? 10000 - offset : 10001 + offset, 1 + ( x >> 20 ) % 50 );
+        }
+        else
+        {
+            book.Cancel ( next - 1 - ( x >> 24 ) % RestingOrders );
+        }
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+
+void BM_BookDepth ( benchmark::State& state )
+{
+    OrderBook book ( 1 << 16 );
+    for ( OrderId id = 1; id <= RestingOrders; id++ )
+    {
+        book.Add ( id, id & 1 ? Side::Bid : Side::Ask, id & 1 ? 10000 - id % 64 : 10001 + id % 64, 10 );
+    }
+    PriceLevel levels[64];
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize ( book.Depth ( Side::Bid, levels, state.range ( 0 ) ) );
+        benchmark::DoNotOptimize ( book.Top() );
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+}
+
+BENCHMARK ( BM_BookUpdate )->Arg ( 16 )->Arg ( 64 )->Arg ( 512 );
+BENCHMARK ( BM_BookDepth )->Arg ( 5 )->Arg ( 20 )->Arg ( 64 );
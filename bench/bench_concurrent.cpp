@@ -0,0 +1,94 @@
+#include <atomic>
+
+#include "bench.h"
+#include "../concurrent.h"
+
+using namespace trade::concurrent;
+
+namespace
+{
+template<class TLock>
+struct Guarded
+{
+    static TLock lock;
+    static long value;
+};
+
+template<class TLock> TLock Guarded<TLock>::lock;
+template<class TLock> long Guarded<TLock>::value = 0;
+
+//acquire/release cost of the lock wrappers, uncontended with one thread and contended beyond
+template<class TLock>
+void BM_Locker ( benchmark::State& state )
+{
+    for ( auto _ : state )
+    {
+        BasicLocker<TLock> lk ( Guarded<TLock>::lock );
+        Guarded<TLock>::value++;
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+
+template<class TLock>
+void BM_SharedLocker ( benchmark::State& state )
+{
+    for ( auto _ : state )
+    {
+        BasicSharedLocker<TLock> lk ( Guarded<TLock>::lock );
+        benchmark::DoNotOptimize ( Guarded<TLock>::value );
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+
+template<class TLock>
+void BM_TryLocker ( benchmark::State& state )
+{
+    long acquired = 0;
+    for ( auto _ : state )
+    {
+        BasicTryLocker<TLock> lk ( Guarded<TLock>::lock );
+        if ( lk.Success() )
+        {
+            Guarded<TLock>::value++;
+            acquired++;
+        }
+    }
+    state.SetItemsProcessed ( state.iterations() );
+    state.counters["success_rate"] = benchmark::Counter ( static_cast<double> ( acquired ) / state.iterations(),
+                                     benchmark::Counter::kAvgThreads );
+}
+
+//read mostly mix, thread 0 writes once every 64 iterations and the others only read
+template<class TLock>
+void BM_ReadMostly ( benchmark::State& state )
+{
+    long i = 0;
+    for ( auto _ : state )
+    {
+        if ( state.thread_index() == 0 && ( i++ & 63 ) == 0 )
+        {
+            BasicLocker<TLock> lk ( Guarded<TLock>::lock );
+            Guarded<TLock>::value++;
+        }
+        else
+        {
+            BasicSharedLocker<TLock> lk ( Guarded<TLock>::lock );
+            benchmark::DoNotOptimize ( Guarded<TLock>::value );
+        }
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+
+typedef ReaderBiasedRWSpinLock<> ReaderBiased;
+}
+
+#define LIBTRADE_BENCH_LOCK(TLock) \
+    BENCHMARK_TEMPLATE ( BM_Locker, TLock )->ThreadRange ( 1, 8 )->UseRealTime(); \
+    BENCHMARK_TEMPLATE ( BM_SharedLocker, TLock )->ThreadRange ( 1, 8 )->UseRealTime(); \
+    BENCHMARK_TEMPLATE ( BM_TryLocker, TLock )->ThreadRange ( 1, 8 )->UseRealTime(); \
+    BENCHMARK_TEMPLATE ( BM_ReadMostly, TLock )->ThreadRange ( 1, 8 )->UseRealTime()
+
+LIBTRADE_BENCH_LOCK ( SpinLock );
+LIBTRADE_BENCH_LOCK ( TicketSpinLock );
+LIBTRADE_BENCH_LOCK ( WriterPreferringRWSpinLock );
+LIBTRADE_BENCH_LOCK ( ReaderBiased );
@@ -0,0 +1,223 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "../container.h"
+
+using namespace trade::bench;
+using namespace trade::concurrent;
+using namespace trade::container;
+
+namespace
+{
+constexpr int Capacity = 4096;
+constexpr long MessagesPerIteration = 1 << 16;
+
+//uniform Push/Pop over the different ring buffer interfaces, Pop returns the number of elements handed out
+template<class TQueue>
+struct Queue
+{
+    explicit Queue ( TQueue& q ) : q ( q )
+    {
+    }
+
+    template<class TElement>
+    inline void Push ( const TElement& e )
+    {
+        q.Enqueue ( e );
+    }
+
+    template<class TFunc>
+    inline long Pop ( const TFunc& action )
+    {
+        long count = 0;
+        q.Dequeue ( [&] ( auto & e )
+        {
+            action ( e );
+            count++;
+        } );
+        return count;
+    }
+
+    TQueue& q;
+};
+
+template<class T, int N, class TWait>
+struct Queue<MPMCWorkQueue<T, N, TWait>>
+{
+    explicit Queue ( MPMCWorkQueue<T, N, TWait>& q ) : q ( q )
+    {
+    }
+
+    inline void Push ( const T& e )
+    {
+        q.Enqueue ( e );
+    }
+
+    template<class TFunc>
+    inline long Pop ( const TFunc& action )
+    {
+        return q.Dequeue ( action );
+    }
+
+    MPMCWorkQueue<T, N, TWait>& q;
+};
+
+//MPMCRingBuffer never refuses an element, keep producers within half a lap of the consumer
+template<class T, int N, class TWait>
+struct Queue<MPMCRingBuffer<T, N, TWait>>
+{
+    explicit Queue ( MPMCRingBuffer<T, N, TWait>& q ) : q ( q )
+    {
+    }
+
+    inline void Push ( const T& e )
+    {
+        while ( q.Size() >= N / 2 )
+        {
+            CpuRelax();
+        }
+        q.Enqueue ( e );
+    }
+
+    template<class TFunc>
+    inline long Pop ( const TFunc& action )
+    {
+        long count = 0;
+        q.Dequeue0 ( [&] ( T & e )
+        {
+            action ( e );
+            count++;
+        } );
+        return count;
+    }
+
+    MPMCRingBuffer<T, N, TWait>& q;
+};
+
+template<class T, int N, int R, class TWait>
+struct Queue<BroadcastRingBuffer<T, N, R, TWait>>
+{
+    explicit Queue ( BroadcastRingBuffer<T, N, R, TWait>& q ) : q ( q ), reader ( q.AddReader() )
+    {
+    }
+
+    inline void Push ( const T& e )
+    {
+        q.Enqueue ( e );
+    }
+
+    template<class TFunc>
+    inline long Pop ( const TFunc& action )
+    {
+        return q.Dequeue ( reader, action );
+    }
+
+    BroadcastRingBuffer<T, N, R, TWait>& q;
+    typename BroadcastRingBuffer<T, N, R, TWait>::Reader* reader;
+};
+
+//range(0): producer threads, range(1): Placement of the consumer relative to the first producer
+template<class TQueue, class TElement>
+void BM_HandOff ( benchmark::State& state )
+{
+    int producers = static_cast<int> ( state.range ( 0 ) );
+    int producer_cpu = -1;
+    int consumer_cpu = -1;
+    if ( !ResolvePlacement ( static_cast<int> ( state.range ( 1 ) ), producer_cpu, consumer_cpu ) )
+    {
+        state.SkipWithError ( "placement not available on this machine" );
+        return;
+    }
+
+    std::unique_ptr<TQueue> q ( new TQueue() );
+    Queue<TQueue> queue ( *q );
+    LatencyRecorder latency ( MessagesPerIteration * 16 );
+    ScopedPin pin ( consumer_cpu );
+
+    long each = MessagesPerIteration / producers;
+    for ( auto _ : state )
+    {
+        std::atomic_bool go ( false );
+        std::vector<std::thread> threads;
+        for ( int p = 0; p < producers; p++ )
+        {
+            threads.emplace_back ( [&, p]
+            {
+                PinThread ( p == 0 ? producer_cpu : -1 );
+                while ( !go.load ( std::memory_order_acquire ) )
+                {
+                    CpuRelax();
+                }
+                TElement e;
+                for ( long i = 0; i < each; i++ )
+                {
+                    e.stamp = Now();
+                    queue.Push ( e );
+                }
+            } );
+        }
+
+        long expected = each * producers;
+        long received = 0;
+        int64_t start = Now();
+        go.store ( true, std::memory_order_release );
+        while ( received < expected )
+        {
+            received += queue.Pop ( [&] ( TElement & e )
+            {
+                latency.Record ( Now() - e.stamp );
+            } );
+        }
+        int64_t end = Now();
+        for ( auto& thread : threads )
+        {
+            thread.join();
+        }
+        state.SetIterationTime ( ( end - start ) / 1e9 );
+    }
+    state.SetItemsProcessed ( state.iterations() * each * producers );
+    state.SetBytesProcessed ( state.iterations() * each * producers * sizeof ( TElement ) );
+    latency.Report ( state );
+}
+
+void SingleProducer ( benchmark::internal::Benchmark* b )
+{
+    for ( int placement = Unpinned; placement <= CrossSocket; placement++ )
+    {
+        b->Args ( { 1, placement } );
+    }
+}
+
+void MultiProducer ( benchmark::internal::Benchmark* b )
+{
+    SingleProducer ( b );
+    for ( int producers : { 2, 4, 8 } )
+    {
+        b->Args ( { producers, Unpinned } );
+    }
+}
+
+template<int S> using SyncRing = SyncRingBuffer<Payload<S>, Capacity, FullPolicy::Spin>;
+template<int S> using SPSCRing = SPSCRingBuffer<Payload<S>, Capacity, BusySpinWait, FullPolicy::Spin>;
+template<int S> using MPSCRing = MPSCRingBuffer<Payload<S>, Capacity, BusySpinWait, FullPolicy::Spin>;
+template<int S> using MPMCRing = MPMCRingBuffer<Payload<S>, Capacity>;
+template<int S> using WorkQueue = MPMCWorkQueue<Payload<S>, Capacity>;
+template<int S> using BroadcastRing = BroadcastRingBuffer<Payload<S>, Capacity>;
+template<int S> using Circular = CircularArray<Payload<S>, Capacity, FullPolicy::Spin>;
+}
+
+#define LIBTRADE_BENCH_QUEUE(Q, Threads) \
+    BENCHMARK_TEMPLATE(BM_HandOff, Q<8>, Payload<8>)->Apply(Threads)->UseManualTime(); \
+    BENCHMARK_TEMPLATE(BM_HandOff, Q<64>, Payload<64>)->Apply(Threads)->UseManualTime(); \
+    BENCHMARK_TEMPLATE(BM_HandOff, Q<256>, Payload<256>)->Apply(Threads)->UseManualTime()
+
+LIBTRADE_BENCH_QUEUE ( SyncRing, MultiProducer );
+LIBTRADE_BENCH_QUEUE ( SPSCRing, SingleProducer );
+LIBTRADE_BENCH_QUEUE ( MPSCRing, MultiProducer );
+LIBTRADE_BENCH_QUEUE ( MPMCRing, MultiProducer );
+LIBTRADE_BENCH_QUEUE ( WorkQueue, MultiProducer );
+LIBTRADE_BENCH_QUEUE ( BroadcastRing, SingleProducer );
+LIBTRADE_BENCH_QUEUE ( Circular, MultiProducer );
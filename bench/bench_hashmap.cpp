@@ -0,0 +1,84 @@
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "../hashmap.h"
+
+using namespace trade::container;
+
+namespace
+{
+struct OrderState
+{
+    uint64_t id;
+    int64_t price;
+    int64_t quantity;
+};
+
+constexpr int Capacity = 1 << 21;
+
+typedef HashMap<uint64_t, OrderState, Capacity> Map;
+
+//lookups of random live order ids among range(0) orders, one item is one lookup
+template<class TFind>
+void RunLookups ( benchmark::State& state, std::vector<uint64_t>& ids, const TFind& find )
+{
+    std::mt19937_64 rng ( 7 );
+    std::vector<uint64_t> queries ( 1 << 16 );
+    for ( auto& q : queries )
+    {
+        q = ids[rng() % ids.size()];
+    }
+    size_t i = 0;
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize ( find ( queries[i++ & ( queries.size() - 1 )] ) );
+    }
+    state.SetItemsProcessed ( state.iterations() );
+}
+
+std::vector<uint64_t> OrderIds ( long count )
+{
+    std::mt19937_64 rng ( 42 );
+    std::vector<uint64_t> ids ( count );
+    for ( auto& id : ids )
+    {
+        id = rng();
+    }
+    return ids;
+}
+
+void BM_HashMapFind ( benchmark::State& state )
+{
+    std::vector<uint64_t> ids = OrderIds ( state.range ( 0 ) );
+    std::unique_ptr<Map> map ( new Map() );
+    for ( uint64_t id : ids )
+    {
+        map->Insert ( id, OrderState { id, 100, 1 } );
+    }
+    RunLookups ( state, ids, [&map] ( uint64_t id )
+    {
+        return map->Find ( id )->quantity;
+    } );
+}
+
+void BM_UnorderedMapFind ( benchmark::State& state )
+{
+    std::vector<uint64_t> ids = OrderIds ( state.range ( 0 ) );
+    std::unordered_map<uint64_t, OrderState> map;
+    map.reserve ( ids.size() );
+    for ( uint64_t id : ids )
+    {
+        map[id] = OrderState { id, 100, 1 };
+    }
+    RunLookups ( state, ids, [&map] ( uint64_t id )
+    {
+        return map.find ( id )->second.quantity;
+    } );
+}
+}
+
+BENCHMARK ( BM_HashMapFind )->Arg ( 1 << 10 )->Arg ( 1 << 16 )->Arg ( 1 << 20 );
+BENCHMARK ( BM_UnorderedMapFind )->Arg ( 1 << 10 )->Arg ( 1 << 16 )->Arg ( 1 << 20 );
@@ -0,0 +1,37 @@
+#include <vector>
+
+#include "bench.h"
+#include "../container.h"
+#include "../simd.h"
+
+using namespace trade;
+
+namespace
+{
+constexpr int Capacity = 1 << 17;
+
+//per tick feature over the last range(1) entries of a ring, range(0) being the simd::Level.
+//the ring has wrapped, so every scan is split in two spans
+void BM_RingScan ( benchmark::State& state )
+{
+    simd::Level previous = simd::Active();
+    simd::Use ( static_cast<simd::Level> ( state.range ( 0 ) ) );
+    static container::SPSCRingBuffer<double, Capacity> ring;
+    for ( long i = 0; i < Capacity + Capacity / 2; i++ )
+    {
+        ring.Enqueue ( 100.0 + ( i % 97 ) * 0.25 );
+    }
+    long last = ring.GetLatestEntryIndex() + 1;
+    long first = last - state.range ( 1 );
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize ( simd::Sum ( ring, first, last ) );
+        benchmark::DoNotOptimize ( simd::Max ( ring, first, last ) );
+        benchmark::DoNotOptimize ( simd::CountGreater ( ring, first, last, 110.0 ) );
+    }
+    state.SetItemsProcessed ( state.iterations() * state.range ( 1 ) );
+    simd::Use ( previous );
+}
+}
+
+BENCHMARK ( BM_RingScan )->ArgsProduct ( { { 0, 1, 2 }, { 1 << 10, 1 << 14, 100000 } } );
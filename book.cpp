@@ -0,0 +1,106 @@
+#include "book.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace trade
+{
+namespace book
+{
+namespace impl
+{
+OrderIndex::OrderIndex ( uint32_t capacity )
+{
+    uint64_t size = 2;
+    int bits = 1;
+    while ( size < 2ull * capacity )
+    {
+        size <<= 1;
+        bits++;
+    }
+    entries.resize ( size );
+    mask = size - 1;
+    shift = 64 - bits;
+    Clear();
+}
+
+void OrderIndex::Clear()
+{
+    for ( Entry& entry : entries )
+    {
+        entry.id = 0;
+        entry.slot = Nil;
+    }
+}
+
+BookSide::BookSide ( bool bid ) : low ( 0 ), best ( NoPrice ), count ( 0 ), bid ( bid )
+{
+    Clear();
+}
+
+void BookSide::Clear()
+{
+    for ( int i = 0; i < Window; i++ )
+    {
+        levels[i] = Level { { NoPrice, 0, 0 }, Nil, Nil };
+    }
+    bitmap.fill ( 0 );
+    best = NoPrice;
+    count = 0;
+}
+
+//slots are addressed by absolute price modulo Window, so as long as every occupied level stays inside the
+//new range nothing has to move: only low changes. the slack is split evenly on both sides
+bool BookSide::Recenter ( Price price )
+{
+    if ( count == 0 )
+    {
+        low = price - Window / 2;
+        return true;
+    }
+    Price lowest = std::min ( price, NextOccupied ( low, low + Window - 1 ) );
+    Price highest = std::max ( price, PrevOccupied ( low + Window - 1, low ) );
+    if ( highest - lowest >= Window )
+    {
+        return false;
+    }
+    low = lowest - ( Window - 1 - ( highest - lowest ) ) / 2;
+    return true;
+}
+}
+
+OrderBook::OrderBook ( uint32_t capacity ) : bids ( true ), asks ( false ), orders ( capacity ), index ( capacity ),
+    free_list ( impl::Nil ), size ( 0 )
+{
+    if ( capacity == 0 || capacity >= impl::Nil )
+    {
+        throw std::invalid_argument ( "OrderBook's capacity must be in [1, 2^32 - 1)" );
+    }
+    Clear();
+}
+
+int OrderBook::Depth ( Side side, PriceLevel* levels, int max ) const
+{
+    const impl::BookSide& book_side = Of ( side );
+    int count = 0;
+    for ( Price price = book_side.Best(); price != NoPrice && count < max; price = book_side.Deeper ( price ) )
+    {
+        levels[count++] = book_side.Find ( price )->summary;
+    }
+    return count;
+}
+
+void OrderBook::Clear()
+{
+    bids.Clear();
+    asks.Clear();
+    index.Clear();
+    for ( uint32_t i = 0; i < orders.size(); i++ )
+    {
+        orders[i].next = i + 1 < orders.size() ? i + 1 : impl::Nil;
+    }
+    free_list = 0;
+    size = 0;
+}
+}
+}
@@ -0,0 +1,587 @@
+#ifndef LIBTRADE_BOOK_H
+#define LIBTRADE_BOOK_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "container.h"
+
+namespace trade
+{
+namespace book
+{
+typedef int64_t Price; // in ticks
+typedef int64_t Quantity;
+typedef uint64_t OrderId;
+
+static constexpr Price NoPrice = std::numeric_limits<Price>::min();
+
+enum class Side : uint8_t
+{
+    Bid,
+    Ask
+};
+
+//aggregated view of one price level, what the snapshots hand out
+struct PriceLevel
+{
+    Price price;
+    Quantity quantity;
+    int orders;
+};
+
+struct TopOfBook
+{
+    PriceLevel bid;
+    PriceLevel ask;
+};
+
+struct Order
+{
+    OrderId id;
+    Price price;
+    Quantity quantity;
+    uint32_t prev;
+    uint32_t next;
+    Side side;
+};
+
+namespace impl
+{
+static constexpr uint32_t Nil = std::numeric_limits<uint32_t>::max();
+
+//order id -> pool slot, open addressing with linear probing and backward shift deletion, so lookups never
+//walk over tombstones. sized once for twice the pool capacity
+class OrderIndex
+{
+public:
+    explicit OrderIndex ( uint32_t capacity );
+
+    inline uint32_t Find ( OrderId id ) const
+    {
+        for ( uint64_t i = Home ( id ); ; i = ( i + 1 ) & mask )
+        {
+            const Entry& entry = entries[i];
+            if ( entry.slot == Nil || entry.id == id )
+            {
+                return entry.slot;
+            }
+        }
+    }
+
+    //false if id is already there
+    inline bool Insert ( OrderId id, uint32_t slot )
+    {
+        for ( uint64_t i = Home ( id ); ; i = ( i + 1 ) & mask )
+        {
+            Entry& entry = entries[i];
+            if ( entry.slot == Nil )
+            {
+                entry.id = id;
+                entry.slot = slot;
+                return true;
+            }
+            if ( entry.id == id )
+            {
+                return false;
+            }
+        }
+    }
+
+    inline void Erase ( OrderId id )
+    {
+        uint64_t i = Home ( id );
+        while ( entries[i].id != id || entries[i].slot == Nil )
+        {
+            if ( entries[i].slot == Nil )
+            {
+                return;
+            }
+            i = ( i + 1 ) & mask;
+        }
+        //pull back every following entry that may live in the hole
+        uint64_t hole = i;
+        for ( uint64_t j = ( i + 1 ) & mask; entries[j].slot != Nil; j = ( j + 1 ) & mask )
+        {
+            uint64_t home = Home ( entries[j].id );
+            if ( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) )
+            {
+                entries[hole] = entries[j];
+                hole = j;
+            }
+        }
+        entries[hole].slot = Nil;
+    }
+
+    void Clear();
+
+private:
+    struct Entry
+    {
+        OrderId id;
+        uint32_t slot;
+    };
+
+    inline uint64_t Home ( OrderId id ) const
+    {
+        return ( id * 0x9E3779B97F4A7C15ull ) >> shift;
+    }
+
+    std::vector<Entry> entries;
+    uint64_t mask;
+    int shift;
+};
+
+//one side of the book: Window price levels in a FixedArray addressed by price modulo Window, valid for the
+//moving range [low, low + Window). a bitmap of occupied levels finds the next best level a word at a time
+class BookSide
+{
+public:
+    static constexpr int Window = 4096;
+
+    struct Level
+    {
+        PriceLevel summary;
+        uint32_t head;
+        uint32_t tail;
+    };
+
+    explicit BookSide ( bool bid );
+
+    //level for price, nullptr when it is outside the window
+    inline Level* Find ( Price price )
+    {
+        return price >= low && price < low + Window ? &levels[price & mask] : nullptr;
+    }
+
+    inline const Level* Find ( Price price ) const
+    {
+        return price >= low && price < low + Window ? &levels[price & mask] : nullptr;
+    }
+
+    //level for price, moving the window if all occupied levels and price still fit. nullptr otherwise
+    inline Level* Open ( Price price )
+    {
+        Level* level = Find ( price );
+        if ( level == nullptr && Recenter ( price ) )
+        {
+            level = &levels[price & mask];
+        }
+        if ( level != nullptr && !Occupied ( price ) )
+        {
+            level->summary.price = price;
+            Occupy ( price );
+        }
+        return level;
+    }
+
+    inline bool Occupied ( Price price ) const
+    {
+        long bit = price & mask;
+        return ( bitmap[bit >> 6] >> ( bit & 63 ) ) & 1;
+    }
+
+    //to be called once a level has neither orders nor quantity left
+    inline void Close ( Price price )
+    {
+        long bit = price & mask;
+        bitmap[bit >> 6] &= ~ ( 1ull << ( bit & 63 ) );
+        levels[bit] = Level { { NoPrice, 0, 0 }, Nil, Nil };
+        count--;
+        if ( price == best )
+        {
+            best = bid ? PrevOccupied ( price, low ) : NextOccupied ( price, low + Window - 1 );
+        }
+    }
+
+    inline Price Best() const
+    {
+        return best;
+    }
+
+    inline const Level& BestLevel() const
+    {
+        return levels[best & mask];
+    }
+
+    inline int LevelCount() const
+    {
+        return count;
+    }
+
+    //next occupied level after price going away from the top, NoPrice if there is none
+    inline Price Deeper ( Price price ) const
+    {
+        return bid ? PrevOccupied ( price - 1, low ) : NextOccupied ( price + 1, low + Window - 1 );
+    }
+
+    void Clear();
+
+private:
+    static constexpr long mask = Window - 1;
+
+    inline void Occupy ( Price price )
+    {
+        long bit = price & mask;
+        bitmap[bit >> 6] |= 1ull << ( bit & 63 );
+        count++;
+        if ( best == NoPrice || ( bid ? price > best : price < best ) )
+        {
+            best = price;
+        }
+    }
+
+    //lowest occupied price in [from, to]
+    inline Price NextOccupied ( Price from, Price to ) const
+    {
+        while ( from <= to )
+        {
+            long bit = from & mask;
+            uint64_t word = bitmap[bit >> 6] >> ( bit & 63 );
+            if ( word != 0 )
+            {
+                Price price = from + __builtin_ctzll ( word );
+                return price <= to ? price : NoPrice;
+            }
+            from += 64 - ( bit & 63 );
+        }
+        return NoPrice;
+    }
+
+    //highest occupied price in [to, from]
+    inline Price PrevOccupied ( Price from, Price to ) const
+    {
+        while ( from >= to )
+        {
+            long bit = from & mask;
+            uint64_t word = bitmap[bit >> 6] << ( 63 - ( bit & 63 ) );
+            if ( word != 0 )
+            {
+                Price price = from - __builtin_clzll ( word );
+                return price >= to ? price : NoPrice;
+            }
+            from -= ( bit & 63 ) + 1;
+        }
+        return NoPrice;
+    }
+
+    bool Recenter ( Price price );
+
+    container::FixedArray<Level, Window> levels;
+    std::array<uint64_t, Window / 64> bitmap;
+    Price low;
+    Price best;
+    int count;
+    bool bid;
+};
+}
+
+//L3 limit order book for one instrument: per level FIFO queues of orders threaded through a preallocated
+//pool by index, an internal id -> order table, and price levels in a window that follows the market (see
+//impl::BookSide). nothing allocates after construction. prices are in ticks, and an order priced more than
+//BookSide::Window ticks away from the other levels of its side is refused. the book does not match, a
+//crossed feed stays crossed
+class OrderBook
+{
+public:
+    explicit OrderBook ( uint32_t capacity = 1 << 20 );
+
+    //false if the id is known already, the pool is exhausted or the price is outside the window
+    inline bool Add ( OrderId id, Side side, Price price, Quantity quantity )
+    {
+        if ( free_list == impl::Nil )
+        {
+            return false;
+        }
+        uint32_t slot = free_list;
+        if ( !index.Insert ( id, slot ) )
+        {
+            return false;
+        }
+        impl::BookSide::Level* level = Of ( side ).Open ( price );
+        if ( level == nullptr )
+        {
+            index.Erase ( id );
+            return false;
+        }
+        free_list = orders[slot].next;
+        Order& order = orders[slot];
+        order.id = id;
+        order.side = side;
+        order.price = price;
+        order.quantity = quantity;
+        Append ( *level, slot );
+        size++;
+        return true;
+    }
+
+    inline bool Cancel ( OrderId id )
+    {
+        uint32_t slot = index.Find ( id );
+        if ( slot == impl::Nil )
+        {
+            return false;
+        }
+        Remove ( slot );
+        return true;
+    }
+
+    //take quantity off an order (a fill), removing it once nothing is left
+    inline bool Execute ( OrderId id, Quantity quantity )
+    {
+        uint32_t slot = index.Find ( id );
+        if ( slot == impl::Nil )
+        {
+            return false;
+        }
+        Order& order = orders[slot];
+        if ( quantity >= order.quantity )
+        {
+            Remove ( slot );
+            return true;
+        }
+        order.quantity -= quantity;
+        Of ( order.side ).Find ( order.price )->summary.quantity -= quantity;
+        return true;
+    }
+
+    //a smaller quantity keeps the order's place in the queue, a bigger one sends it to the back.
+    //zero cancels
+    inline bool Modify ( OrderId id, Quantity quantity )
+    {
+        uint32_t slot = index.Find ( id );
+        if ( slot == impl::Nil )
+        {
+            return false;
+        }
+        if ( quantity <= 0 )
+        {
+            Remove ( slot );
+            return true;
+        }
+        Order& order = orders[slot];
+        impl::BookSide::Level& level = *Of ( order.side ).Find ( order.price );
+        level.summary.quantity += quantity - order.quantity;
+        if ( quantity > order.quantity && level.tail != slot )
+        {
+            Unlink ( level, slot );
+            Link ( level, slot );
+        }
+        order.quantity = quantity;
+        return true;
+    }
+
+    //move an order to another price (back of that queue). false, leaving the order alone, if the new price
+    //is outside the window
+    inline bool Modify ( OrderId id, Price price, Quantity quantity )
+    {
+        uint32_t slot = index.Find ( id );
+        if ( slot == impl::Nil )
+        {
+            return false;
+        }
+        Order& order = orders[slot];
+        if ( price == order.price || quantity <= 0 )
+        {
+            return Modify ( id, quantity );
+        }
+        impl::BookSide& side = Of ( order.side );
+        impl::BookSide::Level* level = side.Open ( price );
+        if ( level == nullptr )
+        {
+            return false;
+        }
+        impl::BookSide::Level& previous = *side.Find ( order.price );
+        previous.summary.quantity -= order.quantity;
+        Unlink ( previous, slot );
+        if ( --previous.summary.orders == 0 )
+        {
+            side.Close ( order.price );
+        }
+        order.price = price;
+        order.quantity = quantity;
+        Append ( *level, slot );
+        return true;
+    }
+
+    //L2 feeds: set the aggregated quantity of a level directly, zero removes it. not to be mixed with
+    //per order updates on the same book
+    inline bool SetLevel ( Side side, Price price, Quantity quantity, int count = 0 )
+    {
+        impl::BookSide& book_side = Of ( side );
+        if ( quantity <= 0 )
+        {
+            impl::BookSide::Level* level = book_side.Find ( price );
+            if ( level != nullptr && book_side.Occupied ( price ) )
+            {
+                book_side.Close ( price );
+            }
+            return true;
+        }
+        impl::BookSide::Level* level = book_side.Open ( price );
+        if ( level == nullptr )
+        {
+            return false;
+        }
+        level->summary.quantity = quantity;
+        level->summary.orders = count;
+        return true;
+    }
+
+    inline const Order* Find ( OrderId id ) const
+    {
+        uint32_t slot = index.Find ( id );
+        return slot == impl::Nil ? nullptr : &orders[slot];
+    }
+
+    inline Price BestBid() const
+    {
+        return bids.Best();
+    }
+
+    inline Price BestAsk() const
+    {
+        return asks.Best();
+    }
+
+    inline PriceLevel Best ( Side side ) const
+    {
+        const impl::BookSide& book_side = Of ( side );
+        return book_side.Best() == NoPrice ? PriceLevel { NoPrice, 0, 0 } : book_side.BestLevel().summary;
+    }
+
+    inline TopOfBook Top() const
+    {
+        return TopOfBook { Best ( Side::Bid ), Best ( Side::Ask ) };
+    }
+
+    //aggregated level at price, quantity 0 if there is none
+    inline PriceLevel Level ( Side side, Price price ) const
+    {
+        const impl::BookSide::Level* level = Of ( side ).Find ( price );
+        return level == nullptr || level->summary.price != price ? PriceLevel { price, 0, 0 } : level->summary;
+    }
+
+    //copy up to max levels from the top into levels, returns how many
+    int Depth ( Side side, PriceLevel* levels, int max ) const;
+
+    //walk the orders at price in time priority
+    template<class TFunc>
+    inline void ForEachOrder ( Side side, Price price, const TFunc& action ) const
+    {
+        const impl::BookSide::Level* level = Of ( side ).Find ( price );
+        if ( level == nullptr || level->summary.price != price )
+        {
+            return;
+        }
+        for ( uint32_t slot = level->head; slot != impl::Nil; slot = orders[slot].next )
+        {
+            action ( orders[slot] );
+        }
+    }
+
+    inline int LevelCount ( Side side ) const
+    {
+        return Of ( side ).LevelCount();
+    }
+
+    inline uint32_t Size() const
+    {
+        return size;
+    }
+
+    inline uint32_t Capacity() const
+    {
+        return static_cast<uint32_t> ( orders.size() );
+    }
+
+    void Clear();
+
+private:
+    OrderBook ( const OrderBook& );
+    OrderBook& operator= ( const OrderBook& ); // non-copyable
+
+    inline impl::BookSide& Of ( Side side )
+    {
+        return side == Side::Bid ? bids : asks;
+    }
+
+    inline const impl::BookSide& Of ( Side side ) const
+    {
+        return side == Side::Bid ? bids : asks;
+    }
+
+    inline void Link ( impl::BookSide::Level& level, uint32_t slot )
+    {
+        Order& order = orders[slot];
+        order.prev = level.tail;
+        order.next = impl::Nil;
+        if ( level.tail == impl::Nil )
+        {
+            level.head = slot;
+        }
+        else
+        {
+            orders[level.tail].next = slot;
+        }
+        level.tail = slot;
+    }
+
+    inline void Unlink ( impl::BookSide::Level& level, uint32_t slot )
+    {
+        Order& order = orders[slot];
+        if ( order.prev == impl::Nil )
+        {
+            level.head = order.next;
+        }
+        else
+        {
+            orders[order.prev].next = order.next;
+        }
+        if ( order.next == impl::Nil )
+        {
+            level.tail = order.prev;
+        }
+        else
+        {
+            orders[order.next].prev = order.prev;
+        }
+    }
+
+    inline void Append ( impl::BookSide::Level& level, uint32_t slot )
+    {
+        Link ( level, slot );
+        level.summary.quantity += orders[slot].quantity;
+        level.summary.orders++;
+    }
+
+    inline void Remove ( uint32_t slot )
+    {
+        Order& order = orders[slot];
+        impl::BookSide& side = Of ( order.side );
+        impl::BookSide::Level& level = *side.Find ( order.price );
+        Unlink ( level, slot );
+        level.summary.quantity -= order.quantity;
+        if ( --level.summary.orders == 0 )
+        {
+            side.Close ( order.price );
+        }
+        index.Erase ( order.id );
+        order.next = free_list;
+        free_list = slot;
+        size--;
+    }
+
+    impl::BookSide bids;
+    impl::BookSide asks;
+    std::vector<Order> orders;
+    impl::OrderIndex index;
+    uint32_t free_list;
+    uint32_t size;
+};
+}
+}
+
+#endif //LIBTRADE_BOOK_H
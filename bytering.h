@@ -0,0 +1,373 @@
+#ifndef LIBTRADE_BYTERING_H
+#define LIBTRADE_BYTERING_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "concurrent.h"
+#include "container.h"
+
+namespace trade
+{
+namespace container
+{
+namespace impl
+{
+//ring of N bytes carrying records of any length, each an 8 byte header and its payload padded to 8 bytes, so
+//small messages pack densely instead of each taking a slot sized for the largest. a record that does not fit
+//before the end of the buffer leaves a padding record there and starts again at 0.
+//single producer: the header is written at Claim and the record published by the store of head at Commit.
+//multi producer: producers reserve space with a CAS on head and each publishes its own record by the release
+//store of its length, which stays 0 until then; the consumer stops at the first uncommitted record and zeroes
+//what it has read before handing the space back. producers never overwrite unread records, P is Reject or Spin
+template<int N, bool MultiProducer, class TWait, FullPolicy P, class TStorage>
+class ByteRingBuffer
+{
+public:
+    static_assert ( ( ( N >= 64 ) && ( ( N & ( ~N + 1 ) ) == N ) ), "a byte ring's size must be a power of 2 of at least 64" );
+    static_assert ( P != FullPolicy::Overwrite, "a byte ring cannot overwrite, readers could not find the next record" );
+
+    static constexpr int32_t PaddingType = -1;
+
+    explicit ByteRingBuffer ( const memory::Placement& placement = memory::Placement() )
+        : words ( placement ), data ( reinterpret_cast<char*> ( &words[0] ) ), head ( 0 ), tail ( 0 ), rejected ( 0 )
+    {
+    }
+
+    //longest payload a record may have
+    static constexpr int32_t MaxLength()
+    {
+        return N / 4 - Header;
+    }
+
+    //room for length bytes of payload, 8 aligned, to be written in place and handed to Commit. nullptr if
+    //length is over MaxLength() or the ring is full and P is Reject. with one producer only one claim may be
+    //outstanding, with several every producer may hold one and the consumer waits at the first uncommitted
+    inline char* Claim ( int32_t type, int32_t length )
+    {
+        if ( length < 0 || length > MaxLength() )
+        {
+            return nullptr;
+        }
+        long size = Align ( Header + length );
+        long current_head = 0;
+        long padding = 0;
+        if ( !Reserve ( size, current_head, padding ) )
+        {
+            return nullptr;
+        }
+        if ( padding > 0 )
+        {
+            WriteHeader ( current_head & mask, static_cast<int32_t> ( padding ), PaddingType, true );
+        }
+        long pos = ( current_head + padding ) & mask;
+        WriteHeader ( pos, Header + length, type, !MultiProducer );
+        if ( !MultiProducer )
+        {
+            claimed_head = current_head + padding + size;
+        }
+        return data + pos + Header;
+    }
+
+    inline void Commit ( char* payload )
+    {
+        if ( MultiProducer )
+        {
+            int32_t* length = reinterpret_cast<int32_t*> ( payload - Header );
+            __atomic_store_n ( length, -*length, __ATOMIC_RELEASE );
+        }
+        else
+        {
+            head.store ( claimed_head, std::memory_order_release );
+        }
+        waiter.Signal();
+    }
+
+    //copy length bytes in as one record, false if it was rejected
+    inline bool Write ( int32_t type, const void* payload, int32_t length )
+    {
+        char* to = Claim ( type, length );
+        if ( to == nullptr )
+        {
+            return false;
+        }
+        std::memcpy ( to, payload, length );
+        Commit ( to );
+        return true;
+    }
+
+    template<class T>
+    inline bool Write ( int32_t type, const T& message )
+    {
+        static_assert ( std::is_trivially_copyable<T>::value, "byte ring records are copied bytewise" );
+        return Write ( type, &message, sizeof ( T ) );
+    }
+
+    //action(int32_t type, const char* payload, int32_t length) on every record committed so far, in place,
+    //then hand the space back. returns how many
+    template<class TFunc>
+    inline long Read ( const TFunc& action )
+    {
+        long current_tail = tail.load ( std::memory_order_relaxed );
+        long end = current_tail;
+        long count = 0;
+        if ( MultiProducer )
+        {
+            long limit = current_tail + N;
+            while ( end < limit )
+            {
+                const int32_t* header = reinterpret_cast<const int32_t*> ( data + ( end & mask ) );
+                int32_t length = __atomic_load_n ( header, __ATOMIC_ACQUIRE );
+                if ( length <= 0 )
+                {
+                    break;
+                }
+                count += Visit ( end, length, header[1], action );
+                end += Align ( length );
+            }
+            Zero ( current_tail, end );
+        }
+        else
+        {
+            long current_head = head.load ( std::memory_order_acquire );
+            while ( end < current_head )
+            {
+                const int32_t* header = reinterpret_cast<const int32_t*> ( data + ( end & mask ) );
+                count += Visit ( end, header[0], header[1], action );
+                end += Align ( header[0] );
+            }
+        }
+        if ( end != current_tail )
+        {
+            tail.store ( end, std::memory_order_release );
+        }
+        return count;
+    }
+
+    //wait up to timeout milliseconds (negative waits forever) according to TWait, then read like Read.
+    //returns false if nothing arrived in time
+    template<class TFunc>
+    inline bool ReadWait ( const TFunc& action, int timeout )
+    {
+        auto ready = [this]
+        {
+            long current_tail = tail.load ( std::memory_order_relaxed );
+            if ( MultiProducer )
+            {
+                return __atomic_load_n ( reinterpret_cast<const int32_t*> ( data + ( current_tail & mask ) ), __ATOMIC_ACQUIRE ) > 0;
+            }
+            return current_tail < head.load ( std::memory_order_acquire );
+        };
+        if ( !waiter.Wait ( ready, timeout ) )
+        {
+            return false;
+        }
+        Read ( action );
+        return true;
+    }
+
+    //bytes claimed and not yet read, padding included
+    inline long Size() const
+    {
+        return head.load ( std::memory_order_acquire ) - tail.load ( std::memory_order_acquire );
+    }
+
+    inline long Capacity() const
+    {
+        return N;
+    }
+
+    //records refused because the ring was full
+    inline long Rejected() const
+    {
+        return rejected.load ( std::memory_order_relaxed );
+    }
+
+private:
+    ByteRingBuffer ( const ByteRingBuffer& );
+    ByteRingBuffer& operator= ( const ByteRingBuffer& ); // non-copyable
+
+    //length (header included, 0 until committed with several producers) and type
+    static constexpr int32_t Header = 8;
+
+    static inline long Align ( long size )
+    {
+        return ( size + 7 ) & ~7L;
+    }
+
+    //find size bytes from head, with padding in front of them if they would run past the end of the buffer,
+    //and take them. a single producer only re-reads tail when its cached copy says the ring is full
+    inline bool Reserve ( long size, long& current_head, long& padding )
+    {
+        current_head = head.load ( std::memory_order_relaxed );
+        while ( true )
+        {
+            long to_end = N - ( current_head & mask );
+            padding = size > to_end ? to_end : 0;
+            long end = current_head + padding + size;
+            long known_tail = MultiProducer ? tail.load ( std::memory_order_acquire ) : cached_tail;
+            if ( !MultiProducer && end - known_tail > N )
+            {
+                cached_tail = known_tail = tail.load ( std::memory_order_acquire );
+            }
+            if ( end - known_tail > N )
+            {
+                if ( P == FullPolicy::Reject )
+                {
+                    rejected.fetch_add ( 1, std::memory_order_relaxed );
+                    return false;
+                }
+                concurrent::CpuRelax();
+                current_head = head.load ( std::memory_order_relaxed );
+                continue;
+            }
+            if ( !MultiProducer )
+            {
+                return true;
+            }
+            if ( head.compare_exchange_weak ( current_head, end, std::memory_order_relaxed ) )
+            {
+                return true;
+            }
+        }
+    }
+
+    //with several producers the length goes in negated, Commit stores it positive
+    inline void WriteHeader ( long pos, int32_t length, int32_t type, bool committed )
+    {
+        int32_t* header = reinterpret_cast<int32_t*> ( data + pos );
+        header[1] = type;
+        if ( committed )
+        {
+            __atomic_store_n ( header, length, __ATOMIC_RELEASE );
+        }
+        else
+        {
+            header[0] = -length;
+        }
+    }
+
+    template<class TFunc>
+    inline long Visit ( long at, int32_t length, int32_t type, const TFunc& action )
+    {
+        if ( type == PaddingType )
+        {
+            return 0;
+        }
+        action ( type, static_cast<const char*> ( data + ( at & mask ) + Header ), length - Header );
+        return 1;
+    }
+
+    //clear read records so that the next lap finds 0 where a record has yet to be committed
+    inline void Zero ( long from, long to )
+    {
+        long count = to - from;
+        if ( count <= 0 )
+        {
+            return;
+        }
+        long pos = from & mask;
+        long first = count < N - pos ? count : N - pos;
+        std::memset ( data + pos, 0, first );
+        std::memset ( data, 0, count - first );
+    }
+
+    static constexpr long mask = N - 1;
+
+    impl::cacheline_pad_t pad0;
+    impl::ValueArray<uint64_t, N / 8, TStorage> words;
+    char* data;
+    impl::cacheline_pad_t pad1;
+    std::atomic_long head;
+    long claimed_head = 0; // single producer only
+    long cached_tail = 0;
+    impl::cacheline_pad_t pad2;
+    std::atomic_long tail;
+    impl::cacheline_pad_t pad3;
+    TWait waiter;
+    impl::cacheline_pad_t pad4;
+    std::atomic_long rejected;
+};
+}
+
+template<int N, class TWait = concurrent::BusySpinWait, FullPolicy P = FullPolicy::Reject, class TStorage = InlineStorage>
+using SPSCByteRingBuffer = impl::ByteRingBuffer<N, false, TWait, P, TStorage>;
+
+template<int N, class TWait = concurrent::BusySpinWait, FullPolicy P = FullPolicy::Reject, class TStorage = InlineStorage>
+using MPSCByteRingBuffer = impl::ByteRingBuffer<N, true, TWait, P, TStorage>;
+
+//a record type of a byte ring and the struct it carries, for Dispatch
+template<int32_t Id, class T>
+struct Case
+{
+    static_assert ( std::is_trivially_copyable<T>::value && alignof ( T ) <= 8, "byte ring records are 8 aligned bytes" );
+
+    static constexpr int32_t Type = Id;
+    typedef T Message;
+};
+
+//consumer side typed dispatch: as the action of Read, hands visitor the payload of a record as the struct its
+//type is registered with and ignores other types, e.g.
+//  ring.Read ( Dispatch<Case<1, Quote>, Case<2, Trade>> ( visitor ) )
+//with visitor ( const Quote& ) and visitor ( const Trade& ) overloads. a record shorter than its struct is
+//ignored too
+template<class TVisitor, class... Cases>
+class Dispatcher
+{
+public:
+    explicit Dispatcher ( TVisitor& visitor ) : visitor ( visitor )
+    {
+    }
+
+    inline void operator() ( int32_t type, const char* payload, int32_t length ) const
+    {
+        Apply<Cases...> ( type, payload, length );
+    }
+
+private:
+    template<class TCase, class... Rest>
+    inline typename std::enable_if < sizeof... ( Rest ) != 0 >::type Apply ( int32_t type, const char* payload,
+            int32_t length ) const
+    {
+        if ( !Match<TCase> ( type, payload, length ) )
+        {
+            Apply<Rest...> ( type, payload, length );
+        }
+    }
+
+    template<class TCase>
+    inline void Apply ( int32_t type, const char* payload, int32_t length ) const
+    {
+        Match<TCase> ( type, payload, length );
+    }
+
+    template<class TCase>
+    inline bool Match ( int32_t type, const char* payload, int32_t length ) const
+    {
+        typedef typename TCase::Message Message;
+        if ( type != TCase::Type )
+        {
+            return false;
+        }
+        if ( length >= static_cast<int32_t> ( sizeof ( Message ) ) )
+        {
+            visitor ( *reinterpret_cast<const Message*> ( payload ) );
+        }
+        return true;
+    }
+
+    TVisitor& visitor;
+};
+
+template<class... Cases, class TVisitor>
+inline Dispatcher<TVisitor, Cases...> Dispatch ( TVisitor& visitor )
+{
+    return Dispatcher<TVisitor, Cases...> ( visitor );
+}
+}
+}
+
+#endif //LIBTRADE_BYTERING_H
@@ -0,0 +1,77 @@
+#include "clock.h"
+
+#include <cmath>
+#include <thread>
+
+#if defined(LIBTRADE_CLOCK_TSC)
+#include <cpuid.h>
+#endif
+
+namespace trade
+{
+namespace concurrent
+{
+namespace impl
+{
+namespace
+{
+//cpuid 0x80000007 edx bit 8: the tsc runs at a constant rate in every p/c state and is synchronised across cores
+bool InvariantTsc()
+{
+#if defined(LIBTRADE_CLOCK_TSC)
+    unsigned int eax, ebx, ecx, edx;
+    if ( __get_cpuid ( 0x80000007, &eax, &ebx, &ecx, &edx ) )
+    {
+        return ( edx & ( 1u << 8 ) ) != 0;
+    }
+#endif
+    return false;
+}
+
+//the tsc read closest to a steady_clock read, bracketing it and keeping the tightest of a few tries
+void Sample ( int64_t& ticks, int64_t& nanos )
+{
+#if defined(LIBTRADE_CLOCK_TSC)
+    int64_t best = INT64_MAX;
+    for ( int i = 0; i < 8; i++ )
+    {
+        int64_t before = static_cast<int64_t> ( __rdtsc() );
+        int64_t now = SteadyNanoseconds();
+        int64_t after = static_cast<int64_t> ( __rdtsc() );
+        if ( after - before < best )
+        {
+            best = after - before;
+            ticks = before + ( after - before ) / 2;
+            nanos = now;
+        }
+    }
+#else
+    ticks = nanos = SteadyNanoseconds();
+#endif
+}
+}
+
+TscCalibration Calibrate()
+{
+    TscCalibration calibration;
+    calibration.invariant = InvariantTsc();
+    if ( !calibration.invariant )
+    {
+        calibration.base_ticks = calibration.base_nanos = 0;
+        calibration.scale = int64_t ( 1 ) << 32;
+        calibration.ticks_per_nanosecond = 1;
+        return calibration;
+    }
+    int64_t ticks0 = 0, nanos0 = 0, ticks1 = 0, nanos1 = 0;
+    Sample ( ticks0, nanos0 );
+    std::this_thread::sleep_for ( std::chrono::milliseconds ( 10 ) );
+    Sample ( ticks1, nanos1 );
+    calibration.ticks_per_nanosecond = static_cast<double> ( ticks1 - ticks0 ) / ( nanos1 - nanos0 );
+    calibration.scale = std::llround ( 4294967296.0 / calibration.ticks_per_nanosecond );
+    calibration.base_ticks = ticks1;
+    calibration.base_nanos = nanos1;
+    return calibration;
+}
+}
+}
+}
@@ -0,0 +1,116 @@
+#ifndef LIBTRADE_CLOCK_H
+#define LIBTRADE_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+#if ( defined(__x86_64__) || defined(_M_X64) ) && ( defined(__GNUC__) || defined(__clang__) )
+#define LIBTRADE_CLOCK_TSC 1
+#include <x86intrin.h>
+#endif
+
+namespace trade
+{
+namespace concurrent
+{
+namespace impl
+{
+//tsc to nanoseconds: nanos = base_nanos + ( ( ticks - base_ticks ) * scale ) >> 32, measured against
+//steady_clock on first use. without an invariant tsc the ticks are steady_clock nanoseconds and scale is 1 << 32
+struct TscCalibration
+{
+    bool invariant;
+    int64_t base_ticks;
+    int64_t base_nanos;
+    int64_t scale;
+    double ticks_per_nanosecond;
+};
+
+TscCalibration Calibrate();
+
+inline const TscCalibration& Tsc()
+{
+    static const TscCalibration calibration = Calibrate();
+    return calibration;
+}
+
+inline int64_t SteadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (
+               std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+}
+
+//time stamp counter read as a clock: a few nanoseconds a read against ~20 for steady_clock, on the same time
+//base as steady_clock. the rate is measured once over ~10ms, so over hours Now() may drift from steady_clock
+//by a few milliseconds: use it for deadlines and intervals, not as a wall clock
+class TscClock
+{
+public:
+    //raw counter, not ordered with the instructions around it
+    static inline int64_t Ticks()
+    {
+#if defined(LIBTRADE_CLOCK_TSC)
+        if ( impl::Tsc().invariant )
+        {
+            return static_cast<int64_t> ( __rdtsc() );
+        }
+#endif
+        return impl::SteadyNanoseconds();
+    }
+
+    //rdtscp: waits until every earlier instruction has executed, for the end of a measured interval
+    static inline int64_t TicksOrdered()
+    {
+#if defined(LIBTRADE_CLOCK_TSC)
+        if ( impl::Tsc().invariant )
+        {
+            unsigned int aux;
+            return static_cast<int64_t> ( __rdtscp ( &aux ) );
+        }
+#endif
+        return impl::SteadyNanoseconds();
+    }
+
+    //nanoseconds on steady_clock's time base
+    static inline int64_t Now()
+    {
+        return ToNanoseconds ( Ticks() );
+    }
+
+    static inline int64_t ToNanoseconds ( int64_t ticks )
+    {
+        const impl::TscCalibration& tsc = impl::Tsc();
+        return tsc.base_nanos + Scale ( ticks - tsc.base_ticks, tsc.scale );
+    }
+
+    //length of an interval measured in ticks
+    static inline int64_t Elapsed ( int64_t from, int64_t to )
+    {
+        return Scale ( to - from, impl::Tsc().scale );
+    }
+
+    static inline bool Invariant()
+    {
+        return impl::Tsc().invariant;
+    }
+
+    static inline double TicksPerNanosecond()
+    {
+        return impl::Tsc().ticks_per_nanosecond;
+    }
+
+private:
+    static inline int64_t Scale ( int64_t ticks, int64_t scale )
+    {
+#if defined(__SIZEOF_INT128__)
+        return static_cast<int64_t> ( ( static_cast<__int128> ( ticks ) * scale ) >> 32 );
+#else
+        return static_cast<int64_t> ( static_cast<long double> ( ticks ) * scale / 4294967296.0L );
+#endif
+    }
+};
+}
+}
+
+#endif //LIBTRADE_CLOCK_H
@@ -0,0 +1,457 @@
+#ifndef LIBTRADE_CODEC_H
+#define LIBTRADE_CODEC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace trade
+{
+namespace codec
+{
+//flyweight binary messages in the manner of SBE: a schema is a type listing fields at fixed offsets, and
+//encoders and decoders are a pointer into someone else's bytes (a ring slot, a journal record, a packet) with
+//accessors that load and store at those offsets. nothing is built, copied or allocated in between, so the same
+//bytes can go from the feed handler through the rings into the journal as they are.
+//a message is a MessageHeader, its fixed block, then any repeating groups and variable length data in the
+//order the encoder appended them, which is the order the decoder must take them in. little endian on the wire,
+//which is also the only byte order this is built for
+
+static_assert ( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "codec reads and writes the wire format natively" );
+
+struct MessageHeader
+{
+    uint16_t block_length; // of the sender's fixed block, a newer schema may have appended fields
+    uint16_t template_id;
+    uint32_t length; // of the whole message, header included
+};
+
+struct GroupHeader
+{
+    uint16_t block_length; // of an entry
+    uint16_t count;
+};
+
+struct DataHeader
+{
+    uint16_t length;
+};
+
+static_assert ( sizeof ( MessageHeader ) == 8 && sizeof ( GroupHeader ) == 4 && sizeof ( DataHeader ) == 2,
+                "codec headers are part of the wire format" );
+
+//a field of type T at Offset bytes into its block. declare each as its own type so that accessors are
+//checked against the schema they are used with: struct Bid : codec::Field<int64_t, 8> {};
+template<class T, std::size_t At>
+struct Field
+{
+    static_assert ( std::is_trivially_copyable<T>::value, "codec fields are copied bytewise" );
+    static_assert ( At % alignof ( T ) == 0, "a codec field must be naturally aligned in its block" );
+
+    typedef T Type;
+    static constexpr std::size_t Offset = At;
+    static constexpr std::size_t Size = sizeof ( T );
+};
+
+namespace impl
+{
+template<class... Fields>
+constexpr bool Ordered()
+{
+    const std::size_t offsets[] = { Fields::Offset..., 0 };
+    const std::size_t sizes[] = { Fields::Size..., 0 };
+    for ( std::size_t i = 0; i + 1 < sizeof... ( Fields ); i++ )
+    {
+        if ( offsets[i] + sizes[i] > offsets[i + 1] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class... Fields>
+constexpr std::size_t End()
+{
+    const std::size_t ends[] = { Fields::Offset + Fields::Size..., 0 };
+    std::size_t end = 0;
+    for ( std::size_t i = 0; i < sizeof... ( Fields ); i++ )
+    {
+        end = ends[i] > end ? ends[i] : end;
+    }
+    return end;
+}
+
+template<class F, class... Fields>
+constexpr bool Contains()
+{
+    const bool same[] = { std::is_same<F, Fields>::value..., false };
+    for ( std::size_t i = 0; i < sizeof... ( Fields ); i++ )
+    {
+        if ( same[i] )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+//a fixed block of fields, the entry of a repeating group. the layout is checked when the schema is compiled:
+//fields declared in offset order, not overlapping and inside BlockLength, so a schema edit that would
+//silently move a field on the wire does not build
+template<std::size_t Length, class... Fields>
+struct Composite
+{
+    static_assert ( impl::Ordered<Fields...>(), "codec fields must be declared in offset order without overlapping" );
+    static_assert ( impl::End<Fields...>() <= Length, "codec fields must lie inside the block" );
+    static_assert ( Length % 8 == 0 && Length < 65536, "a codec block is a multiple of 8 bytes below 64k" );
+
+    static constexpr std::size_t BlockLength = Length;
+
+    template<class F>
+    static constexpr bool Has()
+    {
+        return impl::Contains<F, Fields...>();
+    }
+};
+
+//a message with its template id, e.g.
+//  struct Quote : codec::Message<1, 24, Instrument, Bid, Ask> {};
+template<uint16_t Id, std::size_t Length, class... Fields>
+struct Message : Composite<Length, Fields...>
+{
+    static constexpr uint16_t TemplateId = Id;
+    //encoded length without groups or data
+    static constexpr std::size_t Size = sizeof ( MessageHeader ) + Length;
+};
+
+//bytes a group of count entries adds to a message
+template<class TEntry>
+constexpr std::size_t GroupSize ( std::size_t count )
+{
+    return sizeof ( GroupHeader ) + count * TEntry::BlockLength;
+}
+
+//bytes variable length data of length adds to a message
+constexpr std::size_t DataSize ( std::size_t length )
+{
+    return sizeof ( DataHeader ) + length;
+}
+
+//the template id of an encoded message, to dispatch on before picking a decoder
+inline uint16_t TemplateIdOf ( const void* buffer )
+{
+    MessageHeader header;
+    std::memcpy ( &header, buffer, sizeof ( header ) );
+    return header.template_id;
+}
+
+//aligned storage for a message, to carry in a fixed slot ring: SPSCRingBuffer<codec::Frame<64>, N>
+template<std::size_t Capacity>
+struct alignas ( 8 ) Frame
+{
+    char bytes[Capacity];
+};
+
+//field access to one block
+template<class TBlock>
+class BlockEncoder
+{
+public:
+    explicit BlockEncoder ( char* base ) : base ( base )
+    {
+    }
+
+    template<class F>
+    inline BlockEncoder& Set ( const typename F::Type& value )
+    {
+        static_assert ( TBlock::template Has<F>(), "field is not part of this block" );
+        std::memcpy ( base + F::Offset, &value, sizeof ( value ) );
+        return *this;
+    }
+
+    template<class F>
+    inline typename F::Type Get() const
+    {
+        static_assert ( TBlock::template Has<F>(), "field is not part of this block" );
+        typename F::Type value;
+        std::memcpy ( &value, base + F::Offset, sizeof ( value ) );
+        return value;
+    }
+
+private:
+    char* base;
+};
+
+template<class TBlock>
+class BlockDecoder
+{
+public:
+    explicit BlockDecoder ( const char* base ) : base ( base )
+    {
+    }
+
+    template<class F>
+    inline typename F::Type Get() const
+    {
+        static_assert ( TBlock::template Has<F>(), "field is not part of this block" );
+        typename F::Type value;
+        std::memcpy ( &value, base + F::Offset, sizeof ( value ) );
+        return value;
+    }
+
+private:
+    const char* base;
+};
+
+template<class TEntry>
+class GroupEncoder
+{
+public:
+    GroupEncoder ( char* first, uint16_t count ) : first ( first ), count ( count )
+    {
+    }
+
+    inline BlockEncoder<TEntry> operator[] ( int i ) const
+    {
+        return BlockEncoder<TEntry> ( first + i * TEntry::BlockLength );
+    }
+
+    inline int Count() const
+    {
+        return count;
+    }
+
+private:
+    char* first;
+    uint16_t count;
+};
+
+//entries are as long as the sender's block_length says, which may be longer than TEntry's
+template<class TEntry>
+class GroupDecoder
+{
+public:
+    GroupDecoder ( const char* first, uint16_t stride, uint16_t count ) : first ( first ), stride ( stride ), count ( count )
+    {
+    }
+
+    inline BlockDecoder<TEntry> operator[] ( int i ) const
+    {
+        return BlockDecoder<TEntry> ( first + i * stride );
+    }
+
+    inline int Count() const
+    {
+        return count;
+    }
+
+private:
+    const char* first;
+    uint16_t stride;
+    uint16_t count;
+};
+
+struct Bytes
+{
+    const char* data;
+    uint16_t length;
+};
+
+//writes a message into capacity bytes at buffer (8 aligned): the header and a zeroed block at construction,
+//then fields in any order and groups and data in wire order. running out of capacity is sticky: the group
+//or data that did not fit comes back empty and Ok() turns false. the fixed block must fit
+template<class TMessage>
+class Encoder
+{
+public:
+    Encoder ( void* buffer, std::size_t capacity ) : base ( static_cast<char*> ( buffer ) ), capacity ( capacity )
+    {
+        MessageHeader header { static_cast<uint16_t> ( TMessage::BlockLength ), TMessage::TemplateId,
+                               static_cast<uint32_t> ( TMessage::Size ) };
+        std::memcpy ( base, &header, sizeof ( header ) );
+        std::memset ( base + sizeof ( header ), 0, TMessage::BlockLength );
+    }
+
+    template<std::size_t Capacity>
+    explicit Encoder ( Frame<Capacity>& frame ) : Encoder ( frame.bytes, Capacity )
+    {
+        static_assert ( TMessage::Size <= Capacity, "the message's block does not fit the frame" );
+    }
+
+    template<class F>
+    inline Encoder& Set ( const typename F::Type& value )
+    {
+        Block().template Set<F> ( value );
+        return *this;
+    }
+
+    template<class F>
+    inline typename F::Type Get() const
+    {
+        return Block().template Get<F>();
+    }
+
+    template<class TEntry>
+    inline GroupEncoder<TEntry> Group ( uint16_t count )
+    {
+        std::size_t size = GroupSize<TEntry> ( count );
+        if ( !Reserve ( size ) )
+        {
+            return GroupEncoder<TEntry> ( base, 0 );
+        }
+        GroupHeader header { static_cast<uint16_t> ( TEntry::BlockLength ), count };
+        char* at = base + length;
+        std::memcpy ( at, &header, sizeof ( header ) );
+        std::memset ( at + sizeof ( header ), 0, size - sizeof ( header ) );
+        Grow ( size );
+        return GroupEncoder<TEntry> ( at + sizeof ( header ), count );
+    }
+
+    inline bool Data ( const void* data, uint16_t size )
+    {
+        if ( !Reserve ( DataSize ( size ) ) )
+        {
+            return false;
+        }
+        DataHeader header { size };
+        std::memcpy ( base + length, &header, sizeof ( header ) );
+        std::memcpy ( base + length + sizeof ( header ), data, size );
+        Grow ( DataSize ( size ) );
+        return true;
+    }
+
+    //bytes written, what to publish
+    inline std::size_t Length() const
+    {
+        return length;
+    }
+
+    inline bool Ok() const
+    {
+        return ok;
+    }
+
+private:
+    inline BlockEncoder<TMessage> Block() const
+    {
+        return BlockEncoder<TMessage> ( base + sizeof ( MessageHeader ) );
+    }
+
+    inline bool Reserve ( std::size_t size )
+    {
+        ok = ok && length + size <= capacity;
+        return ok;
+    }
+
+    inline void Grow ( std::size_t size )
+    {
+        length += size;
+        uint32_t total = static_cast<uint32_t> ( length );
+        std::memcpy ( base + offsetof ( MessageHeader, length ), &total, sizeof ( total ) );
+    }
+
+    char* base;
+    std::size_t capacity;
+    std::size_t length = TMessage::Size;
+    bool ok = true;
+};
+
+//reads a message of length bytes at buffer. Valid() checks the template id and that the header's lengths
+//fit; a sender's longer block (a newer schema version) is stepped over. groups and data are taken in wire
+//order, one running past the end comes back empty and clears Valid()
+template<class TMessage>
+class Decoder
+{
+public:
+    Decoder ( const void* buffer, std::size_t length ) : base ( static_cast<const char*> ( buffer ) )
+    {
+        MessageHeader header;
+        if ( length >= sizeof ( header ) )
+        {
+            std::memcpy ( &header, base, sizeof ( header ) );
+            end = std::min<std::size_t> ( header.length, length );
+            position = sizeof ( header ) + header.block_length;
+            valid = header.template_id == TMessage::TemplateId && header.block_length >= TMessage::BlockLength &&
+                    position <= end;
+        }
+    }
+
+    template<std::size_t Capacity>
+    explicit Decoder ( const Frame<Capacity>& frame ) : Decoder ( frame.bytes, Capacity )
+    {
+    }
+
+    inline bool Valid() const
+    {
+        return valid;
+    }
+
+    template<class F>
+    inline typename F::Type Get() const
+    {
+        return BlockDecoder<TMessage> ( base + sizeof ( MessageHeader ) ).template Get<F>();
+    }
+
+    template<class TEntry>
+    inline GroupDecoder<TEntry> Group()
+    {
+        GroupHeader header;
+        if ( !Available ( sizeof ( header ) ) )
+        {
+            return GroupDecoder<TEntry> ( base, 0, 0 );
+        }
+        std::memcpy ( &header, base + position, sizeof ( header ) );
+        std::size_t size = sizeof ( header ) + std::size_t ( header.count ) * header.block_length;
+        if ( header.block_length < TEntry::BlockLength || !Available ( size ) )
+        {
+            valid = false;
+            return GroupDecoder<TEntry> ( base, 0, 0 );
+        }
+        const char* first = base + position + sizeof ( header );
+        position += size;
+        return GroupDecoder<TEntry> ( first, header.block_length, header.count );
+    }
+
+    inline Bytes Data()
+    {
+        DataHeader header;
+        if ( !Available ( sizeof ( header ) ) )
+        {
+            return Bytes { base, 0 };
+        }
+        std::memcpy ( &header, base + position, sizeof ( header ) );
+        if ( !Available ( DataSize ( header.length ) ) )
+        {
+            return Bytes { base, 0 };
+        }
+        Bytes bytes { base + position + sizeof ( header ), header.length };
+        position += DataSize ( header.length );
+        return bytes;
+    }
+
+    //the whole message as the header gives it
+    inline std::size_t Length() const
+    {
+        return end;
+    }
+
+private:
+    inline bool Available ( std::size_t size )
+    {
+        valid = valid && position + size <= end;
+        return valid;
+    }
+
+    const char* base;
+    std::size_t end = 0;
+    std::size_t position = 0;
+    bool valid = false;
+};
+}
+}
+
+#endif //LIBTRADE_CODEC_H
@@ -2,3 +2,211 @@
 // Created by kyl on 2019-06-19.
 //
 
+#include "concurrent.h"
+#include "timer.h"
+
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+namespace trade
+{
+namespace concurrent
+{
+namespace
+{
+//the thread behind DelayRun. due actions are collected under the lock and run after it is released, so an
+//action may call DelayRun again
+class DelayRunner
+{
+public:
+    DelayRunner() : wheel ( 1000000 ), stop ( false ), thread ( [this]
+    {
+        Run();
+    } )
+    {
+    }
+
+    ~DelayRunner()
+    {
+        {
+            std::lock_guard<std::mutex> lock ( protect );
+            stop = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void Add ( std::function<void() > action, std::chrono::nanoseconds delay )
+    {
+        {
+            std::lock_guard<std::mutex> lock ( protect );
+            wheel.After ( delay, Deferred { std::move ( action ), &due } );
+        }
+        wake.notify_one();
+    }
+
+private:
+    struct Deferred
+    {
+        std::function<void() > action;
+        std::vector<std::function<void() >>* due;
+
+        void operator() ()
+        {
+            due->push_back ( std::move ( action ) );
+        }
+    };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock ( protect );
+        while ( !stop )
+        {
+            wheel.Poll();
+            if ( !due.empty() )
+            {
+                std::vector<std::function<void() >> ready;
+                ready.swap ( due );
+                lock.unlock();
+                for ( auto& action : ready )
+                {
+                    action();
+                }
+                lock.lock();
+                continue;
+            }
+            int64_t next = wheel.NextDeadline();
+            if ( next == INT64_MAX )
+            {
+                wake.wait ( lock );
+            }
+            else
+            {
+                wake.wait_for ( lock, std::chrono::nanoseconds ( std::max<int64_t> ( 0, next - TscClock::Now() ) ) );
+            }
+        }
+    }
+
+    TimerWheel<Deferred> wheel;
+    std::vector<std::function<void() >> due;
+    std::mutex protect;
+    std::condition_variable wake;
+    bool stop;
+    std::thread thread;
+};
+}
+
+bool WaitUntil ( std::function<bool() > predicate, int sleep, int timeout )
+{
+    Deadline deadline ( timeout );
+    while ( !predicate() )
+    {
+        if ( deadline.Expired() )
+        {
+            return false;
+        }
+        std::this_thread::sleep_for ( std::chrono::milliseconds ( sleep ) );
+    }
+    return true;
+}
+
+void Sleep ( int sec )
+{
+    std::this_thread::sleep_for ( std::chrono::seconds ( sec ) );
+}
+
+void DelayRun ( std::function<void() > action, int seconds )
+{
+    static DelayRunner runner;
+    runner.Add ( std::move ( action ), std::chrono::seconds ( seconds ) );
+}
+
+AutoResetEvent::AutoResetEvent ( bool initial ) : flag_ ( initial )
+{
+}
+
+void AutoResetEvent::Set()
+{
+    std::lock_guard<std::mutex> lock ( protect_ );
+    flag_ = true;
+    signal_.notify_one();
+}
+
+void AutoResetEvent::Reset()
+{
+    std::lock_guard<std::mutex> lock ( protect_ );
+    flag_ = false;
+}
+
+bool AutoResetEvent::WaitOne()
+{
+    std::unique_lock<std::mutex> lock ( protect_ );
+    while ( !flag_ )
+    {
+        signal_.wait ( lock );
+    }
+    flag_ = false;
+    return true;
+}
+
+bool AutoResetEvent::WaitOne ( int interval )
+{
+    std::unique_lock<std::mutex> lock ( protect_ );
+    if ( !signal_.wait_for ( lock, std::chrono::milliseconds ( interval ), [this] { return flag_; } ) )
+    {
+        return false;
+    }
+    flag_ = false;
+    return true;
+}
+
+SharedAutoResetEvent::SharedAutoResetEvent ( bool initial ) : flag_ ( initial )
+{
+}
+
+void SharedAutoResetEvent::Set()
+{
+    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock ( protect_ );
+    flag_ = true;
+    signal_.notify_one();
+}
+
+void SharedAutoResetEvent::Reset()
+{
+    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock ( protect_ );
+    flag_ = false;
+}
+
+bool SharedAutoResetEvent::WaitOne()
+{
+    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock ( protect_ );
+    while ( !flag_ )
+    {
+        signal_.wait ( lock );
+    }
+    flag_ = false;
+    return true;
+}
+
+bool SharedAutoResetEvent::WaitOne ( int interval )
+{
+    boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock ( protect_ );
+    auto until = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds ( interval );
+    while ( !flag_ )
+    {
+        if ( !signal_.timed_wait ( lock, until ) )
+        {
+            if ( !flag_ )
+            {
+                return false;
+            }
+            break;
+        }
+    }
+    flag_ = false;
+    return true;
+}
+}
+}
@@ -5,8 +5,6 @@
 #ifndef LIBTRADE_CONCURRENT_H
 #define LIBTRADE_CONCURRENT_H
 
-#include <boost/noncopyable.hpp>
-
 #if !defined(_WIN32) && !defined(_WIN64)
 #else
 #if defined(_WIN32) ||  defined(_WIN64)
@@ -19,459 +17,443 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 #include <functional>
-#if !defined(_WIN32) && !defined(_WIN64)
-#include <folly/RWSpinLock.h>
+#include <array>
+#include <cstdint>
+
+#if !defined(_WIN32) && !defined(_WIN64) && ( defined(__x86_64__) || defined(__i386__) )
+#include <immintrin.h>
 #endif
 
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
 
-#if defined(_WIN32) || defined(_WIN32)
 
-#if defined(__GNUC__) && __GNUC__ >= 4
-#define LIKELY(x)   (__builtin_expect((x), 1))
-#define UNLIKELY(x) (__builtin_expect((x), 0))
-#else
-#define LIKELY(x)   (x)
-#define UNLIKELY(x) (x)
-#endif
-
-namespace folly
-{
-class RWSpinLock : boost::noncopyable
-{
-enum : int32_t { READER = 4, UPGRADED = 2, WRITER = 1 };
-public:
-RWSpinLock() : bits_(0) {}
 
-// Lockable Concept
-void lock()
+namespace trade
 {
-    /*    int count = 0;
-    while (!LIKELY(try_lock())) {
-    if (++count > 1000) YieldProcessor();
-    }*/
-}
-
-// Writer is responsible for clearing up both the UPGRADED and WRITER bits.
-void unlock()
+namespace concurrent
 {
-    /*        static_assert(READER > WRITER + UPGRADED, "wrong bits!");
-    bits_.fetch_and(~(WRITER | UPGRADED), std::memory_order_release);*/
-}
+//check predicate every sleep milliseconds until it holds (true) or timeout milliseconds, negative for never, pass
+bool WaitUntil ( std::function<bool() > predicate, int sleep, int timeout );
 
-// SharedLockable Concept
-void lock_shared()
-{
-    int count = 0;
-    while (!LIKELY(try_lock_shared()))
-    {
-        if (++count > 1000) YieldProcessor();
-    }
-}
+void Sleep(int sec);
 
-void unlock_shared()
-{
-    bits_.fetch_add(-READER, std::memory_order_release);
-}
+//run action on a shared background thread after seconds. the thread sleeps on a millisecond timer wheel until
+//the next deadline instead of polling; actions still pending at exit are dropped
+void DelayRun ( std::function<void() > action, int seconds );
 
-// Downgrade the lock from writer status to reader status.
-void unlock_and_lock_shared()
+class AutoResetEvent
 {
-    bits_.fetch_add(READER, std::memory_order_acquire);
-    unlock();
-}
+public:
+    explicit AutoResetEvent ( bool initial = false );
 
-// UpgradeLockable Concept
-void lock_upgrade()
-{
-    int count = 0;
-    while (!try_lock_upgrade())
-    {
-        if (++count > 1000) YieldProcessor();
-    }
-}
+    void Set();
+    void Reset();
+    bool WaitOne();
+    bool WaitOne ( int interval );
+private:
+    AutoResetEvent ( const AutoResetEvent& );
+    AutoResetEvent& operator= ( const AutoResetEvent& ); // non-copyable
+    bool flag_;
+    std::mutex protect_;
+    std::condition_variable signal_;
+};
 
-void unlock_upgrade()
+class SharedAutoResetEvent
 {
-    bits_.fetch_add(-UPGRADED, std::memory_order_acq_rel);
-}
+public:
+    explicit SharedAutoResetEvent ( bool initial = false );
 
-// unlock upgrade and try to acquire write lock
-void unlock_upgrade_and_lock()
-{
-    int64_t count = 0;
-    while (!try_unlock_upgrade_and_lock())
-    {
-        if (++count > 1000) YieldProcessor();
-    }
-}
+    void Set();
+    void Reset();
 
-// unlock upgrade and read lock atomically
-void unlock_upgrade_and_lock_shared()
-{
-    bits_.fetch_add(READER - UPGRADED, std::memory_order_acq_rel);
-}
+    bool WaitOne();
 
-// write unlock and upgrade lock atomically
-void unlock_and_lock_upgrade()
-{
-    // need to do it in two steps here -- as the UPGRADED bit might be OR-ed at
-    // the same time when other threads are trying do try_lock_upgrade().
-    bits_.fetch_or(UPGRADED, std::memory_order_acquire);
-    bits_.fetch_add(-WRITER, std::memory_order_release);
-}
+    bool WaitOne ( int interval );
 
+private:
+    SharedAutoResetEvent ( const SharedAutoResetEvent& );
+    SharedAutoResetEvent& operator= ( const SharedAutoResetEvent& ); // non-copyable
+    bool flag_;
+    boost::interprocess::interprocess_condition signal_;
+    boost::interprocess::interprocess_mutex protect_;
+};
 
-// Attempt to acquire writer permission. Return false if we didn't get it.
-bool try_lock()
+inline void CpuRelax()
 {
-    int32_t expect = 0;
-    return bits_.compare_exchange_strong(expect, WRITER,
-                                         std::memory_order_acq_rel);
+#if defined(_WIN32) || defined(_WIN64)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile ( "yield" ::: "memory" );
+#endif
 }
 
-// Try to get reader permission on the lock. This can fail if we
-// find out someone is a writer or upgrader.
-// Setting the UPGRADED bit would allow a writer-to-be to indicate
-// its intention to write and block any new readers while waiting
-// for existing readers to finish and release their read locks. This
-// helps avoid starving writers (promoted from upgraders).
-bool try_lock_shared()
+//exponential pause backoff for spin loops, falls back to yield once a lock has been busy for long,
+//so that a preempted owner gets the core back
+class SpinBackoff
 {
-    // fetch_add is considerably (100%) faster than compare_exchange,
-    // so here we are optimizing for the common (lock success) case.
-    int32_t value = bits_.fetch_add(READER, std::memory_order_acquire);
-    if (UNLIKELY(value & (WRITER | UPGRADED)))
+public:
+    inline void Pause()
     {
-        bits_.fetch_add(-READER, std::memory_order_release);
-        return false;
+        if ( spins < MaxSpins )
+        {
+            for ( int i = 0; i < pauses; i++ )
+            {
+                CpuRelax();
+            }
+            if ( pauses < MaxPauses )
+            {
+                pauses <<= 1;
+            }
+            spins++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
     }
-    return true;
-}
 
-// try to unlock upgrade and write lock atomically
-bool try_unlock_upgrade_and_lock()
-{
-    int32_t expect = UPGRADED;
-    return bits_.compare_exchange_strong(expect, WRITER,
-                                         std::memory_order_acq_rel);
-}
-
-// try to acquire an upgradable lock.
-bool try_lock_upgrade()
-{
-    int32_t value = bits_.fetch_or(UPGRADED, std::memory_order_acquire);
-
-    // Note: when failed, we cannot flip the UPGRADED bit back,
-    // as in this case there is either another upgrade lock or a write lock.
-    // If it's a write lock, the bit will get cleared up when that lock's done
-    // with unlock().
-    return ((value & (UPGRADED | WRITER)) == 0);
-}
-
-// mainly for debugging purposes.
-int32_t bits() const
-{
-    return bits_.load(std::memory_order_acquire);
-}
+private:
+    static constexpr int MaxPauses = 64;
+    static constexpr int MaxSpins = 1024;
+    int pauses = 1;
+    int spins = 0;
+};
 
-class ReadHolder;
-class UpgradedHolder;
-class WriteHolder;
+// Spin locks. all of them model Lockable and SharedLockable (lock, try_lock, unlock, lock_shared,
+// try_lock_shared, unlock_shared) so they can be handed to the lockers below and to the Sync containers
+// through their TLock parameter. the exclusive only ones map the shared calls to the exclusive ones
 
-class ReadHolder
+//test and test-and-set spin lock, smallest and fastest when uncontended
+class SpinLock
 {
 public:
-    explicit ReadHolder(RWSpinLock* lock = nullptr) : lock_(lock)
+    SpinLock() : locked ( false )
     {
-        if (lock_) lock_->lock_shared();
     }
 
-    explicit ReadHolder(RWSpinLock& lock) : lock_(&lock)
+    inline void lock()
     {
-        lock_->lock_shared();
-    }
-
-    ReadHolder(ReadHolder&& other) : lock_(other.lock_)
-    {
-        other.lock_ = nullptr;
-    }
-
-    // down-grade
-    explicit ReadHolder(UpgradedHolder&& upgraded) : lock_(upgraded.lock_)
-    {
-        upgraded.lock_ = nullptr;
-        if (lock_) lock_->unlock_upgrade_and_lock_shared();
+        SpinBackoff backoff;
+        while ( locked.exchange ( true, std::memory_order_acquire ) )
+        {
+            while ( locked.load ( std::memory_order_relaxed ) )
+            {
+                backoff.Pause();
+            }
+        }
     }
 
-    explicit ReadHolder(WriteHolder&& writer) : lock_(writer.lock_)
+    inline bool try_lock()
     {
-        writer.lock_ = nullptr;
-        if (lock_) lock_->unlock_and_lock_shared();
+        return !locked.load ( std::memory_order_relaxed ) && !locked.exchange ( true, std::memory_order_acquire );
     }
 
-    ReadHolder& operator= (ReadHolder&& other)
+    inline void unlock()
     {
-        using std::swap;
-        swap(lock_, other.lock_);
-        return *this;
+        locked.store ( false, std::memory_order_release );
     }
 
-    ReadHolder(const ReadHolder& other) = delete;
-    ReadHolder& operator= (const ReadHolder& other) = delete;
-
-    ~ReadHolder()
+    inline void lock_shared()
     {
-        if (lock_) lock_->unlock_shared();
+        lock();
     }
 
-    void reset(RWSpinLock* lock = nullptr)
+    inline bool try_lock_shared()
     {
-        if (lock == lock_) return;
-        if (lock_) lock_->unlock_shared();
-        lock_ = lock;
-        if (lock_) lock_->lock_shared();
+        return try_lock();
     }
 
-    void swap(ReadHolder* other)
+    inline void unlock_shared()
     {
-        std::swap(lock_, other->lock_);
+        unlock();
     }
 
 private:
-    friend class UpgradedHolder;
-    friend class WriteHolder;
-    RWSpinLock* lock_;
+    SpinLock ( const SpinLock& );
+    SpinLock& operator= ( const SpinLock& ); // non-copyable
+    std::atomic_bool locked;
 };
 
-class UpgradedHolder
+//FIFO fair ticket lock, waiters back off in proportion to their distance from the head of the line
+class TicketSpinLock
 {
 public:
-    explicit UpgradedHolder(RWSpinLock* lock = nullptr) : lock_(lock)
-    {
-        if (lock_) lock_->lock_upgrade();
-    }
-
-    explicit UpgradedHolder(RWSpinLock& lock) : lock_(&lock)
+    TicketSpinLock() : next ( 0 ), serving ( 0 )
     {
-        lock_->lock_upgrade();
     }
 
-    explicit UpgradedHolder(WriteHolder&& writer)
+    inline void lock()
     {
-        lock_ = writer.lock_;
-        writer.lock_ = nullptr;
-        if (lock_) lock_->unlock_and_lock_upgrade();
+        uint32_t ticket = next.fetch_add ( 1, std::memory_order_relaxed );
+        while ( true )
+        {
+            uint32_t current = serving.load ( std::memory_order_acquire );
+            if ( current == ticket )
+            {
+                return;
+            }
+            for ( uint32_t i = 0; i < ( ticket - current ) * PausesPerWaiter; i++ )
+            {
+                CpuRelax();
+            }
+            if ( ticket - current > 1 )
+            {
+                std::this_thread::yield();
+            }
+        }
     }
 
-    UpgradedHolder(UpgradedHolder&& other) : lock_(other.lock_)
+    inline bool try_lock()
     {
-        other.lock_ = nullptr;
+        uint32_t current = serving.load ( std::memory_order_relaxed );
+        uint32_t expected = current;
+        return next.compare_exchange_strong ( expected, current + 1, std::memory_order_acquire );
     }
 
-    UpgradedHolder& operator = (UpgradedHolder&& other)
+    inline void unlock()
     {
-        using std::swap;
-        swap(lock_, other.lock_);
-        return *this;
+        serving.store ( serving.load ( std::memory_order_relaxed ) + 1, std::memory_order_release );
     }
 
-    UpgradedHolder(const UpgradedHolder& other) = delete;
-    UpgradedHolder& operator = (const UpgradedHolder& other) = delete;
-
-    ~UpgradedHolder()
+    inline void lock_shared()
     {
-        if (lock_) lock_->unlock_upgrade();
+        lock();
     }
 
-    void reset(RWSpinLock* lock = nullptr)
+    inline bool try_lock_shared()
     {
-        if (lock == lock_) return;
-        if (lock_) lock_->unlock_upgrade();
-        lock_ = lock;
-        if (lock_) lock_->lock_upgrade();
+        return try_lock();
     }
 
-    void swap(UpgradedHolder* other)
+    inline void unlock_shared()
     {
-        using std::swap;
-        swap(lock_, other->lock_);
+        unlock();
     }
 
 private:
-    friend class WriteHolder;
-    friend class ReadHolder;
-    RWSpinLock* lock_;
+    TicketSpinLock ( const TicketSpinLock& );
+    TicketSpinLock& operator= ( const TicketSpinLock& ); // non-copyable
+    static constexpr uint32_t PausesPerWaiter = 16;
+    std::atomic<uint32_t> next;
+    std::atomic<uint32_t> serving;
 };
 
-class WriteHolder
+//reader/writer spin lock preferring writers: a waiting writer raises PENDING, which keeps new readers out
+//until it got the lock, so a stream of readers cannot starve it. this is the default lock of the Sync
+//containers and replaces folly::RWSpinLock
+class WriterPreferringRWSpinLock
 {
-public:
-    explicit WriteHolder(RWSpinLock* lock = nullptr) : lock_(lock)
-    {
-        if (lock_) lock_->lock();
-    }
+    enum : int32_t { WRITER = 1, PENDING = 2, READER = 4 };
 
-    explicit WriteHolder(RWSpinLock& lock) : lock_(&lock)
+public:
+    WriterPreferringRWSpinLock() : bits ( 0 )
     {
-        lock_->lock();
     }
 
-    // promoted from an upgrade lock holder
-    explicit WriteHolder(UpgradedHolder&& upgraded)
+    inline void lock()
     {
-        lock_ = upgraded.lock_;
-        upgraded.lock_ = nullptr;
-        if (lock_) lock_->unlock_upgrade_and_lock();
+        SpinBackoff backoff;
+        while ( true )
+        {
+            int32_t value = bits.load ( std::memory_order_relaxed );
+            if ( ( value & ~PENDING ) == 0 )
+            {
+                if ( bits.compare_exchange_weak ( value, WRITER, std::memory_order_acquire ) )
+                {
+                    return;
+                }
+            }
+            else if ( ( value & PENDING ) == 0 )
+            {
+                bits.fetch_or ( PENDING, std::memory_order_relaxed );
+            }
+            backoff.Pause();
+        }
     }
 
-    WriteHolder(WriteHolder&& other) : lock_(other.lock_)
+    inline bool try_lock()
     {
-        other.lock_ = nullptr;
+        int32_t value = bits.load ( std::memory_order_relaxed );
+        return ( value & ~PENDING ) == 0 && bits.compare_exchange_strong ( value, WRITER, std::memory_order_acquire );
     }
 
-    WriteHolder& operator = (WriteHolder&& other)
+    inline void unlock()
     {
-        using std::swap;
-        swap(lock_, other.lock_);
-        return *this;
+        bits.fetch_and ( ~WRITER, std::memory_order_release );
     }
 
-    WriteHolder(const WriteHolder& other) = delete;
-    WriteHolder& operator = (const WriteHolder& other) = delete;
-
-    ~WriteHolder()
+    inline void lock_shared()
     {
-        if (lock_) lock_->unlock();
+        SpinBackoff backoff;
+        while ( !try_lock_shared() )
+        {
+            backoff.Pause();
+        }
     }
 
-    void reset(RWSpinLock* lock = nullptr)
+    inline bool try_lock_shared()
     {
-        if (lock == lock_) return;
-        if (lock_) lock_->unlock();
-        lock_ = lock;
-        if (lock_) lock_->lock();
+        int32_t value = bits.load ( std::memory_order_relaxed );
+        return ( value & ( WRITER | PENDING ) ) == 0
+               && bits.compare_exchange_strong ( value, value + READER, std::memory_order_acquire );
     }
 
-    void swap(WriteHolder* other)
+    inline void unlock_shared()
     {
-        using std::swap;
-        swap(lock_, other->lock_);
+        bits.fetch_sub ( READER, std::memory_order_release );
     }
 
 private:
-    friend class ReadHolder;
-    friend class UpgradedHolder;
-    RWSpinLock* lock_;
+    WriterPreferringRWSpinLock ( const WriterPreferringRWSpinLock& );
+    WriterPreferringRWSpinLock& operator= ( const WriterPreferringRWSpinLock& ); // non-copyable
+    std::atomic<int32_t> bits;
 };
 
-// Synchronized<> adaptors
-friend void acquireRead(RWSpinLock& l)
-{
-    return l.lock_shared();
-}
-friend void acquireReadWrite(RWSpinLock& l)
+typedef WriterPreferringRWSpinLock RWSpinLock;
+
+namespace impl
 {
-    return l.lock();
-}
-friend void releaseRead(RWSpinLock& l)
+//stable small index per thread, used to spread readers over per core counters
+inline unsigned ThreadSlot()
 {
-    return l.unlock_shared();
+    static std::atomic<unsigned> next_slot ( 0 );
+    thread_local unsigned slot = next_slot.fetch_add ( 1, std::memory_order_relaxed );
+    return slot;
 }
-friend void releaseReadWrite(RWSpinLock& l)
-{
-    return l.unlock();
 }
 
-private:
-    std::atomic<int32_t> bits_;
-};
-
-} // namespace folly
-
-
-namespace trade
-{
-namespace concurrent
+//reader biased reader/writer spin lock: every reader only touches its own padded counter (one per thread
+//slot, i.e. one per core when threads are pinned), so read locking does not bounce a shared cache line.
+//writers pay for it by scanning all Slots counters, and new readers wait while a writer holds or waits
+template<int Slots = 16>
+class ReaderBiasedRWSpinLock
 {
-bool WaitUntil ( std::function<bool() > predicate, int sleep, int timeout );
+public:
+    ReaderBiasedRWSpinLock() : writer ( false )
+    {
+        for ( auto& counter : readers )
+        {
+            counter.count.store ( 0, std::memory_order_relaxed );
+        }
+    }
 
-void Sleep(int sec);
+    inline void lock()
+    {
+        SpinBackoff backoff;
+        while ( writer.exchange ( true, std::memory_order_seq_cst ) )
+        {
+            backoff.Pause();
+        }
+        for ( auto& counter : readers )
+        {
+            while ( counter.count.load ( std::memory_order_seq_cst ) != 0 )
+            {
+                backoff.Pause();
+            }
+        }
+    }
 
-// void DelayRun(std::function<void (  ) > action, int seconds);
+    inline bool try_lock()
+    {
+        if ( writer.load ( std::memory_order_relaxed ) || writer.exchange ( true, std::memory_order_seq_cst ) )
+        {
+            return false;
+        }
+        for ( auto& counter : readers )
+        {
+            if ( counter.count.load ( std::memory_order_seq_cst ) != 0 )
+            {
+                writer.store ( false, std::memory_order_release );
+                return false;
+            }
+        }
+        return true;
+    }
 
-class AutoResetEvent
-{
-public:
-    explicit AutoResetEvent ( bool initial = false );
+    inline void unlock()
+    {
+        writer.store ( false, std::memory_order_release );
+    }
 
-    void Set();
-    void Reset();
-    bool WaitOne();
-    bool WaitOne ( int interval );
-private:
-    AutoResetEvent ( const AutoResetEvent& );
-    AutoResetEvent& operator= ( const AutoResetEvent& ); // non-copyable
-    bool flag_;
-    std::mutex protect_;
-    std::condition_variable signal_;
-};
+    inline void lock_shared()
+    {
+        SpinBackoff backoff;
+        while ( !try_lock_shared() )
+        {
+            backoff.Pause();
+        }
+    }
 
-class SharedAutoResetEvent
-{
-public:
-    explicit SharedAutoResetEvent ( bool initial = false );
+    inline bool try_lock_shared()
+    {
+        Counter& counter = readers[impl::ThreadSlot() % Slots];
+        counter.count.fetch_add ( 1, std::memory_order_seq_cst );
+        if ( writer.load ( std::memory_order_seq_cst ) )
+        {
+            counter.count.fetch_sub ( 1, std::memory_order_release );
+            return false;
+        }
+        return true;
+    }
 
-    void Set();
-    void Reset();
+    inline void unlock_shared()
+    {
+        readers[impl::ThreadSlot() % Slots].count.fetch_sub ( 1, std::memory_order_release );
+    }
 
-    bool WaitOne();
+private:
+    ReaderBiasedRWSpinLock ( const ReaderBiasedRWSpinLock& );
+    ReaderBiasedRWSpinLock& operator= ( const ReaderBiasedRWSpinLock& ); // non-copyable
 
-    bool WaitOne ( int interval );
+    struct alignas ( 64 ) Counter
+    {
+        std::atomic_int count;
+    };
 
-private:
-    SharedAutoResetEvent ( const SharedAutoResetEvent& );
-    SharedAutoResetEvent& operator= ( const SharedAutoResetEvent& ); // non-copyable
-    bool flag_;
-    boost::interprocess::interprocess_condition signal_;
-    boost::interprocess::interprocess_mutex protect_;
+    std::atomic_bool writer;
+    std::array<Counter, Slots> readers;
 };
 
-struct Locker
+template<class TLock>
+struct BasicLocker
 {
-    Locker ( folly::RWSpinLock& l ) : locker ( l )
+    BasicLocker ( TLock& l ) : locker ( l )
     {
         locker.lock();
     }
-    Locker ( const folly::RWSpinLock& l ) : locker ( const_cast<folly::RWSpinLock&> ( l ) )
+    BasicLocker ( const TLock& l ) : locker ( const_cast<TLock&> ( l ) )
     {
         locker.lock();
     }
-    ~Locker()
+    ~BasicLocker()
     {
         locker.unlock();
     }
 
 private:
-    folly::RWSpinLock& locker;
+    TLock& locker;
 };
 
-struct TryLocker
+template<class TLock>
+struct BasicTryLocker
 {
-    TryLocker ( folly::RWSpinLock& l ) : locker ( l )
+    BasicTryLocker ( TLock& l ) : locker ( l )
     {
         success = locker.try_lock();
     }
-    TryLocker ( const folly::RWSpinLock& l ) : locker ( const_cast<folly::RWSpinLock&> ( l ) )
+    BasicTryLocker ( const TLock& l ) : locker ( const_cast<TLock&> ( l ) )
     {
         success = locker.try_lock();
     }
-    ~TryLocker()
+    ~BasicTryLocker()
     {
         if ( success )
         {
@@ -485,40 +467,42 @@ struct TryLocker
     }
 
 private:
-    folly::RWSpinLock& locker;
+    TLock& locker;
     bool success = true;
 };
 
-struct SharedLocker
+template<class TLock>
+struct BasicSharedLocker
 {
-    SharedLocker ( folly::RWSpinLock& l ) : locker ( l )
+    BasicSharedLocker ( TLock& l ) : locker ( l )
     {
         locker.lock_shared();
     }
-    SharedLocker ( const folly::RWSpinLock& l ) : locker ( const_cast<folly::RWSpinLock&> ( l ) )
+    BasicSharedLocker ( const TLock& l ) : locker ( const_cast<TLock&> ( l ) )
     {
         locker.lock_shared();
     }
-    ~SharedLocker()
+    ~BasicSharedLocker()
     {
         locker.unlock_shared();
     }
 
 private:
-    folly::RWSpinLock& locker;
+    TLock& locker;
 };
 
-struct TrySharedLocker
+template<class TLock>
+struct BasicTrySharedLocker
 {
-    TrySharedLocker ( folly::RWSpinLock& l ) : locker ( l )
+    BasicTrySharedLocker ( TLock& l ) : locker ( l )
     {
         success = locker.try_lock_shared();
     }
-    TrySharedLocker ( const folly::RWSpinLock& l ) : locker ( const_cast<folly::RWSpinLock&> ( l ) )
+    BasicTrySharedLocker ( const TLock& l ) : locker ( const_cast<TLock&> ( l ) )
     {
         success = locker.try_lock_shared();
     }
-    ~TrySharedLocker()
+    ~BasicTrySharedLocker()
     {
         if ( success )
         {
@@ -532,31 +516,233 @@ struct TrySharedLocker
     }
 
 private:
-    folly::RWSpinLock& locker;
+    TLock& locker;
     bool success = true;
 };
 
-// obsolete to reader/writer in folly from facebook
-#if !defined(_WIN32) && !defined(_WIN32)
-class SpinLock
+typedef BasicLocker<RWSpinLock> Locker;
+typedef BasicTryLocker<RWSpinLock> TryLocker;
+typedef BasicSharedLocker<RWSpinLock> SharedLocker;
+typedef BasicTrySharedLocker<RWSpinLock> TrySharedLocker;
+
+class Deadline
 {
-//public:
-//    SpinLock(std::atomic_flag l):lock(l)
-//    {
-//
-//        while (lock.test_and_set(std::memory_order_acquire))  // acquire lock
-//            std::this_thread::sleep_for(0); ; // spin
-//    }
-//
-//    ~Spinlock(){  lock.clear(std::memory_order_release);  }             // release lock
-//private:
-//    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+public:
+    //timeout in milliseconds, negative means never expire
+    explicit Deadline ( int timeout ) : infinite ( timeout < 0 ),
+        until ( std::chrono::steady_clock::now() + std::chrono::milliseconds ( timeout < 0 ? 0 : timeout ) )
+    {
+    }
+
+    inline bool Expired() const
+    {
+        return !infinite && std::chrono::steady_clock::now() >= until;
+    }
+
+    //milliseconds left, -1 if infinite
+    inline int Remaining() const
+    {
+        if ( infinite )
+        {
+            return -1;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds> ( until - std::chrono::steady_clock::now() ).count();
+        return left > 0 ? static_cast<int> ( left ) : 0;
+    }
+
+private:
+    bool infinite;
+    std::chrono::steady_clock::time_point until;
 };
 
-class RWSpinLock
+// Wait strategies used as template policy by the ring buffers in container.h.
+// Producers call Signal() after publishing, consumers call Wait(ready, timeout) which returns true as
+// soon as ready() holds, or false once timeout milliseconds (negative waits forever) have passed.
+
+//burn the core, lowest latency
+class BusySpinWait
 {
+public:
+    inline void Signal()
+    {
+    }
+
+    template<class TPred>
+    inline bool Wait ( const TPred& ready, int timeout )
+    {
+        if ( ready() )
+        {
+            return true;
+        }
+        Deadline deadline ( timeout );
+        for ( unsigned spins = 1; ; spins++ )
+        {
+            if ( ready() )
+            {
+                return true;
+            }
+            if ( ( spins & 1023 ) == 0 && deadline.Expired() )
+            {
+                return false;
+            }
+        }
+    }
 };
-#endif
+
+//spin with exponential pause backoff, leaves the pipeline to the SMT sibling while waiting
+class PauseSpinWait
+{
+public:
+    inline void Signal()
+    {
+    }
+
+    template<class TPred>
+    inline bool Wait ( const TPred& ready, int timeout )
+    {
+        if ( ready() )
+        {
+            return true;
+        }
+        Deadline deadline ( timeout );
+        int backoff = 1;
+        for ( unsigned spins = 1; ; spins++ )
+        {
+            for ( int i = 0; i < backoff; i++ )
+            {
+                CpuRelax();
+            }
+            if ( ready() )
+            {
+                return true;
+            }
+            if ( backoff < MaxBackoff )
+            {
+                backoff <<= 1;
+            }
+            if ( ( spins & 63 ) == 0 && deadline.Expired() )
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    static constexpr int MaxBackoff = 64;
+};
+
+//pause-spin for a while, then give the core away with yield
+class YieldWait
+{
+public:
+    inline void Signal()
+    {
+    }
+
+    template<class TPred>
+    inline bool Wait ( const TPred& ready, int timeout )
+    {
+        Deadline deadline ( timeout );
+        for ( int spins = 0; spins < SpinTries; spins++ )
+        {
+            if ( ready() )
+            {
+                return true;
+            }
+            CpuRelax();
+        }
+        while ( !ready() )
+        {
+            if ( deadline.Expired() )
+            {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+private:
+    static constexpr int SpinTries = 100;
+};
+
+//pause-spin for a while, then sleep on an auto reset event until a producer signals.
+//producers only pay for Set() while a consumer is actually asleep. with TEvent = SharedAutoResetEvent the
+//strategy itself can be placed in shared memory and wake consumers in other processes
+template<class TEvent>
+class BasicBlockingWait
+{
+public:
+    BasicBlockingWait() : waiters ( 0 )
+    {
+    }
+
+    inline void Signal()
+    {
+        //pairs with the fence in Wait: either the consumer sees the new element or we see the waiter
+        std::atomic_thread_fence ( std::memory_order_seq_cst );
+        if ( waiters.load ( std::memory_order_relaxed ) > 0 )
+        {
+            event.Set();
+        }
+    }
+
+    template<class TPred>
+    inline bool Wait ( const TPred& ready, int timeout )
+    {
+        Deadline deadline ( timeout );
+        for ( int spins = 0; spins < SpinTries; spins++ )
+        {
+            if ( ready() )
+            {
+                return true;
+            }
+            CpuRelax();
+        }
+        while ( true )
+        {
+            waiters.fetch_add ( 1, std::memory_order_relaxed );
+            std::atomic_thread_fence ( std::memory_order_seq_cst );
+            bool success = ready();
+            if ( !success )
+            {
+                int remaining = deadline.Remaining();
+                if ( remaining < 0 )
+                {
+                    event.WaitOne();
+                }
+                else if ( remaining > 0 )
+                {
+                    event.WaitOne ( remaining );
+                }
+                success = ready();
+            }
+            int others = waiters.fetch_sub ( 1, std::memory_order_relaxed ) - 1;
+            if ( success )
+            {
+                //the event wakes a single thread, pass the wake up on to other sleeping consumers
+                if ( others > 0 )
+                {
+                    event.Set();
+                }
+                return true;
+            }
+            if ( deadline.Expired() )
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    static constexpr int SpinTries = 100;
+    std::atomic_int waiters;
+    TEvent event;
+};
+
+typedef BasicBlockingWait<AutoResetEvent> BlockingWait;
+typedef BasicBlockingWait<SharedAutoResetEvent> SharedBlockingWait;
+
 }
 }
 
@@ -5,18 +5,300 @@
 #ifndef LIBTRADE_CONTAINER_H
 #define LIBTRADE_CONTAINER_H
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <cassert>
+#include <cmath>
 #include <functional>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#if !defined(_WIN32) && !defined(_WIN64)
-#include <folly/RWSpinLock.h>
-#endif
+#include "concurrent.h"
+#include "memory.h"
 
 namespace trade
 {
 namespace container
 {
+//where a ring keeps its N slots: inside the ring object itself, wherever that was allocated
+struct InlineStorage
+{
+    template<class U, int N>
+    class Array
+    {
+    public:
+        explicit Array ( const memory::Placement& )
+        {
+        }
+
+        inline U* Data()
+        {
+            return data;
+        }
+
+        inline const U* Data() const
+        {
+            return data;
+        }
+
+    private:
+        U data[N];
+    };
+};
+
+//or in a memory::Region of their own, placed as told by the memory::Placement given to the ring's
+//constructor: 2MB/1GB huge pages, bound to a NUMA node and faulted in up front. the ring object stays small
+struct MappedStorage
+{
+    template<class U, int N>
+    class Array
+    {
+    public:
+        explicit Array ( const memory::Placement& placement )
+            : region ( sizeof ( U ) * N, placement ), data ( static_cast<U*> ( region.Data() ) )
+        {
+        }
+
+        inline U* Data()
+        {
+            return data;
+        }
+
+        inline const U* Data() const
+        {
+            return data;
+        }
+
+        inline const memory::Region& Region() const
+        {
+            return region;
+        }
+
+    private:
+        memory::Region region;
+        U* data;
+    };
+};
+
+namespace impl
+{
+static constexpr int cacheline_size = 64;
+typedef char cacheline_pad_t[cacheline_size];
+
+constexpr int Log2 ( long n )
+{
+    return n <= 1 ? 0 : 1 + Log2 ( n >> 1 );
+}
+
+//raw aligned storage for N contiguous elements, constructed in place on first use. an element stays alive
+//until its slot is reused or the array is destroyed, so readers with a cursor may still look at consumed
+//entries. the live flags are only touched by whoever owns the slot at the time, they follow the elements in
+//the same TStorage block so that mapped storage takes a single region
+template<class T, int N, class TStorage = InlineStorage>
+class SlotArray
+{
+public:
+    explicit SlotArray ( const memory::Placement& placement = memory::Placement() )
+        : storage ( placement )
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            Live ( i ) = false;
+        }
+    }
+
+    ~SlotArray()
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            Destroy ( i );
+        }
+    }
+
+    inline T& operator [] ( long pos )
+    {
+        return *reinterpret_cast<T*> ( &storage.Data()->slots[pos] );
+    }
+
+    inline const T& operator [] ( long pos ) const
+    {
+        return *reinterpret_cast<const T*> ( &storage.Data()->slots[pos] );
+    }
+
+    //destroy the previous occupant and construct a new element from args. only for slots no reader can be
+    //looking at, Renew for rings whose readers may be lapped
+    template<class... Args>
+    inline T& Construct ( long pos, Args&& ... args )
+    {
+        Destroy ( pos );
+        T* t = new ( &storage.Data()->slots[pos] ) T ( std::forward<Args> ( args )... );
+        Live ( pos ) = true;
+        return *t;
+    }
+
+    //assign to the previous occupant, which keeps whatever it has allocated, or construct when there is none
+    template<class U>
+    inline T& Assign ( long pos, U&& value )
+    {
+        if ( !Live ( pos ) )
+        {
+            return Construct ( pos, std::forward<U> ( value ) );
+        }
+        T& t = ( *this ) [pos];
+        t = std::forward<U> ( value );
+        return t;
+    }
+
+    //an element from args without destroying the previous occupant, which gets it assigned: a lapped reader
+    //still looking at the slot reads a valid object, if not the one it expected
+    template<class... Args>
+    inline T& Renew ( long pos, Args&& ... args )
+    {
+        if ( !Live ( pos ) )
+        {
+            return Construct ( pos, std::forward<Args> ( args )... );
+        }
+        T& t = ( *this ) [pos];
+        t = T ( std::forward<Args> ( args )... );
+        return t;
+    }
+
+    //the occupant of a slot, default constructed if there is none yet
+    inline T& Acquire ( long pos )
+    {
+        return Live ( pos ) ? ( *this ) [pos] : Construct ( pos );
+    }
+
+    inline T* Acquire ( long pos, long count )
+    {
+        for ( long i = pos; i < pos + count; i++ )
+        {
+            Acquire ( i );
+        }
+        return & ( *this ) [pos];
+    }
+
+private:
+    SlotArray ( const SlotArray& );
+    SlotArray& operator= ( const SlotArray& ); // non-copyable
+
+    inline bool& Live ( long pos )
+    {
+        return storage.Data()->live[pos];
+    }
+
+    inline void Destroy ( long pos )
+    {
+        if ( Live ( pos ) )
+        {
+            Live ( pos ) = false;
+            ( *this ) [pos].~T();
+        }
+    }
+
+    typedef typename std::aligned_storage<sizeof ( T ), alignof ( T )>::type Slot;
+
+    struct Block
+    {
+        Slot slots[N];
+        bool live[N];
+    };
+
+    typename TStorage::template Array<Block, 1> storage;
+};
+
+//N default constructed elements in TStorage, the std::array of rings whose readers may look at any slot
+template<class T, int N, class TStorage = InlineStorage>
+class ValueArray
+{
+public:
+    explicit ValueArray ( const memory::Placement& placement = memory::Placement() ) : storage ( placement )
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            new ( &storage.Data() [i] ) T();
+        }
+    }
+
+    ~ValueArray()
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            ( *this ) [i].~T();
+        }
+    }
+
+    inline T& operator [] ( long pos )
+    {
+        return *reinterpret_cast<T*> ( &storage.Data() [pos] );
+    }
+
+    inline const T& operator [] ( long pos ) const
+    {
+        return *reinterpret_cast<const T*> ( &storage.Data() [pos] );
+    }
+
+private:
+    ValueArray ( const ValueArray& );
+    ValueArray& operator= ( const ValueArray& ); // non-copyable
+
+    typename TStorage::template Array<typename std::aligned_storage<sizeof ( T ), alignof ( T )>::type, N> storage;
+};
+}
+
+//what a producer does when the ring is full: overwrite the oldest element (readers that get lapped skip
+//ahead and count the loss in Overrun()), drop the new one (counted in Rejected()), or spin until there is room
+enum class FullPolicy
+{
+    Overwrite,
+    Reject,
+    Spin
+};
+
+//slot handed out by the Claim methods of the rings: the element is already constructed in place and becomes
+//visible to consumers when it is handed back to Commit. false when nothing could be claimed
+template<class T>
+class ClaimedSlot
+{
+public:
+    ClaimedSlot() : item ( nullptr ), position ( -1 )
+    {
+    }
+
+    ClaimedSlot ( T* item, long position ) : item ( item ), position ( position )
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return item != nullptr;
+    }
+
+    inline T& operator*() const
+    {
+        return *item;
+    }
+
+    inline T* operator->() const
+    {
+        return item;
+    }
+
+    inline long Position() const
+    {
+        return position;
+    }
+
+private:
+    T* item;
+    long position;
+};
+
 template<class T, int N>
 class FixedArray
 {
@@ -31,6 +313,16 @@ public:
         return data[pos];
     }
 
+    inline const T& at(int pos) const
+    {
+        return data[pos];
+    }
+
+    inline const T& operator [](int pos) const
+    {
+        return data[pos];
+    }
+
     inline int size() const
     {
         return N;
@@ -40,7 +332,197 @@ private:
     T data[N];
 };
 
-template<class T, int N>
+//a value with one writer and any number of readers, none of them ever blocked: the writer makes a sequence
+//counter odd around each store, readers copy the value and retry while the counter was odd or moved under
+//them. T must be trivially copyable and should be small, a torn copy is thrown away, never used
+template<class T>
+class Seqlock
+{
+public:
+    static_assert ( std::is_trivially_copyable<T>::value, "Seqlock copies T while it may be written, it must be trivially copyable" );
+
+    Seqlock() : seq ( 0 ), value()
+    {
+    }
+
+    explicit Seqlock ( const T& initial ) : seq ( 0 ), value ( initial )
+    {
+    }
+
+    //writer only
+    inline void Store ( const T& t )
+    {
+        Modify ( [&t] ( T & current )
+        {
+            current = t;
+        } );
+    }
+
+    //writer only, action(T&) updates the value in place
+    template<class TFunc>
+    inline void Modify ( const TFunc& action )
+    {
+        uint64_t s = seq.load ( std::memory_order_relaxed );
+        seq.store ( s + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence ( std::memory_order_release );
+        action ( value );
+        seq.store ( s + 2, std::memory_order_release );
+    }
+
+    //one attempt, false if the writer was in the middle of a store
+    inline bool TryLoad ( T& out ) const
+    {
+        uint64_t version;
+        return TryLoad ( out, version );
+    }
+
+    //one attempt, version is the number of stores the copy has seen
+    inline bool TryLoad ( T& out, uint64_t& version ) const
+    {
+        uint64_t s = seq.load ( std::memory_order_acquire );
+        if ( s & 1 )
+        {
+            return false;
+        }
+        T copy = value;
+        std::atomic_thread_fence ( std::memory_order_acquire );
+        if ( seq.load ( std::memory_order_relaxed ) != s )
+        {
+            return false;
+        }
+        out = copy;
+        version = s >> 1;
+        return true;
+    }
+
+    inline T Load() const
+    {
+        T out;
+        while ( !TryLoad ( out ) )
+        {
+            concurrent::CpuRelax();
+        }
+        return out;
+    }
+
+    //stores so far, cheap to poll for a change before copying
+    inline uint64_t Version() const
+    {
+        return seq.load ( std::memory_order_acquire ) >> 1;
+    }
+
+private:
+    Seqlock ( const Seqlock& );
+    Seqlock& operator= ( const Seqlock& ); // non-copyable
+
+    std::atomic<uint64_t> seq;
+    T value;
+};
+
+//the newest of a stream of values (top of book, a position, a signal) for readers that never want the older
+//ones, in place of a ring kept only for GetLatestEntryToRead(), which may hand out a slot being written.
+//on a cache line of its own
+template<class T>
+class alignas ( impl::cacheline_size ) LatestValue
+{
+public:
+    LatestValue() = default;
+
+    explicit LatestValue ( const T& initial ) : value ( initial )
+    {
+    }
+
+    inline void Publish ( const T& t )
+    {
+        value.Store ( t );
+    }
+
+    inline T Load() const
+    {
+        return value.Load();
+    }
+
+    //copy the value into out if it changed since seen, and advance seen. a reader keeps its own seen,
+    //starting at 0, so that it only copies what is new to it
+    inline bool Poll ( T& out, uint64_t& seen ) const
+    {
+        uint64_t version = value.Version();
+        if ( version == seen )
+        {
+            return false;
+        }
+        while ( !value.TryLoad ( out, version ) )
+        {
+            concurrent::CpuRelax();
+        }
+        seen = version;
+        return true;
+    }
+
+    inline uint64_t Version() const
+    {
+        return value.Version();
+    }
+
+private:
+    Seqlock<T> value;
+};
+
+//LatestValue for N keys, e.g. one per instrument index: each on its own cache line, so the writer updating
+//one instrument never sends readers of another into a retry
+template<class T, int N, class TStorage = InlineStorage>
+class SeqlockArray
+{
+public:
+    explicit SeqlockArray ( const memory::Placement& placement = memory::Placement() ) : values ( placement )
+    {
+    }
+
+    inline void Publish ( long i, const T& t )
+    {
+        values[i].Publish ( t );
+    }
+
+    inline T Load ( long i ) const
+    {
+        return values[i].Load();
+    }
+
+    inline bool Poll ( long i, T& out, uint64_t& seen ) const
+    {
+        return values[i].Poll ( out, seen );
+    }
+
+    inline uint64_t Version ( long i ) const
+    {
+        return values[i].Version();
+    }
+
+    inline LatestValue<T>& operator [] ( long i )
+    {
+        return values[i];
+    }
+
+    inline const LatestValue<T>& operator [] ( long i ) const
+    {
+        return values[i];
+    }
+
+    static constexpr long Size()
+    {
+        return N;
+    }
+
+private:
+    SeqlockArray ( const SeqlockArray& );
+    SeqlockArray& operator= ( const SeqlockArray& ); // non-copyable
+
+    impl::ValueArray<LatestValue<T>, N, TStorage> values;
+};
+
+//push_back may reallocate and move every element, see SegmentedLog for stable references.
+//TLock is any of the concurrent spin locks, e.g. concurrent::SpinLock when there is no shared access
+template<class T, int N, class TLock = concurrent::RWSpinLock>
 class SyncList
 {
 public:
@@ -50,16 +532,16 @@ public:
 
         inline void Enqueue ( const T& t )
         {
-            using namespace natural_threading;
-            Locker lk ( locker );
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( locker );
             buffer.push_back ( t );
         }
 
         template<class TFunc>
         inline void Emplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            Locker lk ( locker );
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( locker );
             auto it = buffer.emplace ( buffer.end() );
             action ( *it );
         }
@@ -87,7 +569,7 @@ public:
         template<class TFunc>
         inline long Dequeue ( long cursor, const TFunc& action )
         {
-            using namespace natural_threading;
+            using namespace concurrent;
             //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
             while ( true )
             {
@@ -126,183 +608,1162 @@ public:
     private:
         std::vector<T> buffer;
         T t;
-        folly::RWSpinLock locker;
+        TLock locker;
     };
 
-    template<class T, int N>
-    class SyncRingBuffer
+    //append only log made of fixed chunks of N elements hung off an atomic directory of D chunk pointers.
+    //unlike SyncList nothing ever moves, so references from operator[] stay valid for the life of the log
+    //and there is no reallocation stall. appends are wait free for a single writer apart from allocating a
+    //chunk every N elements (use Reserve to do that up front), and any number of readers may scan
+    //concurrently with operator[] and Dequeue(cursor, ...) below GetEndIndex()
+    template<class T, int N, int D = 4096>
+    class SegmentedLog
     {
     public:
-        SyncRingBuffer()
+        SegmentedLog() : size ( 0 ), allocated ( 0 )
         {
+            for ( auto& chunk : directory )
+            {
+                chunk.store ( nullptr, std::memory_order_relaxed );
+            }
+        }
+
+        ~SegmentedLog()
+        {
+            for ( auto& chunk : directory )
+            {
+                delete[] chunk.load ( std::memory_order_relaxed );
+            }
         }
 
         static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
-                        "SyncRingBuffer's size must be a positive power of 2" );
+                        "SegmentedLog's chunk size must be a positive power of 2" );
 
         inline void Enqueue ( const T& t )
         {
-            using namespace natural_threading;
-            Locker lk ( headlocker );
+            long index = size.load ( std::memory_order_relaxed );
+            Chunk ( index ) [index & mask] = t;
+            size.store ( index + 1, std::memory_order_release );
+        }
+
+        template<class TFunc>
+        inline void Emplace ( const TFunc& action )
+        {
+            long index = size.load ( std::memory_order_relaxed );
+            action ( Chunk ( index ) [index & mask] );
+            size.store ( index + 1, std::memory_order_release );
+        }
+
+        //allocate the chunks for count elements now instead of on the append path. writer thread only
+        inline void Reserve ( long count )
+        {
+            for ( long index = allocated * N; index < count; index += N )
+            {
+                Chunk ( index );
+            }
+        }
+
+        inline long GetLatestEntryIndex() const
+        {
+            return size.load ( std::memory_order_acquire ) - 1;
+        }
+
+        inline long GetEndIndex() const
+        {
+            return size.load ( std::memory_order_acquire );
+        }
+
+        inline const T& GetLatestEntryToRead() const
+        {
+            return this->operator[] ( GetLatestEntryIndex() );
+        }
+
+        inline const T& operator [] ( long i ) const
+        {
+            return i < 0 ? empty : directory[i >> shift].load ( std::memory_order_acquire ) [i & mask];
+        }
+
+        template<class TFunc>
+        inline long Dequeue ( long cursor, const TFunc& action )
+        {
+            long end = size.load ( std::memory_order_acquire );
+            while ( cursor < end )
+            {
+                T* chunk = directory[cursor >> shift].load ( std::memory_order_acquire );
+                long last = std::min<long> ( end, ( cursor | mask ) + 1 );
+                for ( ; cursor < last; cursor++ )
+                {
+                    action ( chunk[cursor & mask] );
+                }
+            }
+            return cursor;
+        }
+
+        inline long Size() const
+        {
+            return size.load ( std::memory_order_acquire );
+        }
+
+        //forget the content but keep the chunks for reuse, not safe against concurrent readers
+        inline void Clear()
+        {
+            size.store ( 0, std::memory_order_release );
+        }
+
+        inline long Capacity() const
+        {
+            return static_cast<long> ( N ) * D;
+        }
+
+    private:
+        SegmentedLog ( const SegmentedLog& );
+        SegmentedLog& operator= ( const SegmentedLog& ); // non-copyable
+
+        inline T* Chunk ( long index )
+        {
+            long slot = index >> shift;
+            if ( slot < allocated )
+            {
+                return directory[slot].load ( std::memory_order_relaxed );
+            }
+            if ( slot >= D )
+            {
+                throw std::length_error ( "SegmentedLog is full" );
+            }
+            T* chunk = new T[N];
+            directory[slot].store ( chunk, std::memory_order_release );
+            allocated = slot + 1;
+            return chunk;
+        }
+
+        static constexpr long mask = N - 1;
+        static constexpr int shift = impl::Log2 ( N );
+
+        impl::cacheline_pad_t pad0;
+        std::atomic_long size;
+        long allocated;
+        impl::cacheline_pad_t pad1;
+        std::array<std::atomic<T*>, D> directory;
+        T empty = T();
+    };
+
+    template<class T, int N, FullPolicy P = FullPolicy::Overwrite, class TLock = concurrent::RWSpinLock>
+    class SyncRingBuffer
+    {
+    public:
+        SyncRingBuffer() : rejected ( 0 ), overrun ( 0 )
+        {
+        }
+
+        static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                        "SyncRingBuffer's size must be a positive power of 2" );
+
+        //returns false if the element was dropped because the buffer is full and P is Reject
+        inline bool Enqueue ( const T& t )
+        {
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( P ) )
+            {
+                return false;
+            }
+            buffer[head & mask] = t;
+            head++;
+            return true;
+        }
+
+        //never overwrites unread elements whatever P is
+        inline bool TryEnqueue ( const T& t )
+        {
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( FullPolicy::Reject ) )
+            {
+                return false;
+            }
             buffer[head & mask] = t;
             head++;
+            return true;
+        }
+
+        template<class TFunc>
+        inline bool Emplace ( const TFunc& action )
+        {
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( P ) )
+            {
+                return false;
+            }
+            action ( buffer[head & mask] );
+            head++;
+            return true;
+        }
+
+        inline long GetLatestEntryIndex() const
+        {
+            return head - 1;
+        }
+
+        inline long GetEndIndex() const
+        {
+            return head;
+        }
+
+        inline const T& GetLatestEntryToRead() const
+        {
+            return this->operator[] ( GetLatestEntryIndex() );
+        }
+
+        inline const T& operator [] ( long i ) const
+        {
+            return buffer[i & mask];
+        }
+
+        //with P Overwrite (and always for a cursor) a producer may start rewriting a slot while it is read, so
+        //elements are copied out and checked against head before action sees the copy. one that may have been
+        //rewritten is skipped and counted in Overrun()
+        template<class TFunc>
+        inline void Dequeue ( const TFunc& action )
+        {
+            using namespace concurrent;
+            while ( true )
+            {
+                T* t = nullptr;
+                long index = 0;
+                {
+                    BasicLocker<TLock> lk ( taillocker );
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        tail = SkipLapped ( tail );
+                    }
+                    if ( tail < head )
+                    {
+                        index = tail;
+                        t = & ( buffer[tail & mask] );
+                        tail ++;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                if ( P == FullPolicy::Overwrite )
+                {
+                    Deliver ( index, action );
+                }
+                else
+                {
+                    action ( *t );
+                }
+            }
+        }
+
+        template<class TFunc>
+        inline void Dequeue0 ( const TFunc& action )
+        {
+            using namespace concurrent;
+            while ( true )
+            {
+                T* t = nullptr;
+                long index = 0;
+                {
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        tail = SkipLapped ( tail );
+                    }
+                    if ( tail < head )
+                    {
+                        index = tail;
+                        t = & ( buffer[tail & mask] );
+                        tail ++;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                if ( P == FullPolicy::Overwrite )
+                {
+                    Deliver ( index, action );
+                }
+                else
+                {
+                    action ( *t );
+                }
+            }
+        }
+
+        template<class TFunc>
+        inline long Dequeue ( long cursor, const TFunc& action )
+        {
+            using namespace concurrent;
+            while ( true )
+            {
+                cursor = SkipLapped ( cursor );
+                if ( cursor >= head )
+                {
+                    break;
+                }
+                Deliver ( cursor, action );
+                cursor ++;
+            }
+            return cursor;
+        }
+
+        inline int Size() const
+        {
+            return head - tail;
+        }
+
+        inline void Clear()
+        {
+            head = 0;
+            tail = 0;
+        }
+
+        inline long Capacity() const
+        {
+            return N;
+        }
+
+        //elements refused because the buffer was full
+        inline long Rejected() const
+        {
+            return rejected.load ( std::memory_order_relaxed );
+        }
+
+        //elements overwritten before a reader got to them
+        inline long Overrun() const
+        {
+            return overrun.load ( std::memory_order_relaxed );
+        }
+
+    private:
+        //called with headlocker held. tail is only read, so consumers never wait for producers
+        inline bool Reserve ( FullPolicy policy )
+        {
+            if ( policy == FullPolicy::Overwrite )
+            {
+                return true;
+            }
+            while ( head - tail >= N )
+            {
+                if ( policy == FullPolicy::Reject )
+                {
+                    rejected.fetch_add ( 1, std::memory_order_relaxed );
+                    return false;
+                }
+                concurrent::CpuRelax();
+            }
+            return true;
+        }
+
+        //a reader N elements behind head has been lapped: the slot it is about to read is being rewritten.
+        //move it to the oldest intact element and count the lost ones
+        inline long SkipLapped ( long cursor )
+        {
+            long current_head = head;
+            if ( current_head - cursor >= N )
+            {
+                long oldest = current_head - N + 1;
+                overrun.fetch_add ( oldest - cursor, std::memory_order_relaxed );
+                return oldest;
+            }
+            return cursor;
+        }
+
+        //the same check once element index has been read, seqlock style: head reaching a lap past it means a
+        //producer may have been rewriting the slot during the read. the element counts as lost
+        inline bool Overwritten ( long index )
+        {
+            std::atomic_thread_fence ( std::memory_order_acquire );
+            if ( head - index >= N )
+            {
+                overrun.fetch_add ( 1, std::memory_order_relaxed );
+                return true;
+            }
+            return false;
+        }
+
+        //hand action a copy of element index unless it may have been rewritten while being copied
+        template<class TFunc>
+        inline void Deliver ( long index, const TFunc& action )
+        {
+            T copy = buffer[index & mask];
+            if ( !Overwritten ( index ) )
+            {
+                action ( copy );
+            }
+        }
+
+        impl::cacheline_pad_t pad0;
+        std::array<T, N> buffer;
+        impl::cacheline_pad_t pad1;
+        volatile long head = 0;
+        impl::cacheline_pad_t pad2;
+        volatile long tail = 0;
+        impl::cacheline_pad_t pad3;
+        long mask = N - 1;
+        TLock headlocker;
+        impl::cacheline_pad_t pad4;
+        TLock taillocker;
+        impl::cacheline_pad_t pad5;
+        std::atomic_long rejected;
+        std::atomic_long overrun;
+    };
+
+    //TStorage is InlineStorage or MappedStorage, the latter placed by placement
+    template<class T, int N, class TWait = concurrent::BusySpinWait, FullPolicy P = FullPolicy::Overwrite,
+             class TStorage = InlineStorage>
+    class SPSCRingBuffer
+    {
+    public:
+        explicit SPSCRingBuffer ( const memory::Placement& placement = memory::Placement() )
+            : buffer ( placement ), head ( 0 ), tail ( 0 ), rejected ( 0 ), overrun ( 0 )
+        {
+        }
+
+        static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                        "SPSCRingBuffer's size must be a positive power of 2" );
+
+        typedef T value_type;
+
+        //returns false if the element was dropped because the buffer is full and P is Reject
+        inline bool Enqueue ( const T& t )
+        {
+            return Put ( t, P );
+        }
+
+        inline bool Enqueue ( T&& t )
+        {
+            return Put ( std::move ( t ), P );
+        }
+
+        //never overwrites unread elements whatever P is
+        inline bool TryEnqueue ( const T& t )
+        {
+            return Put ( t, FullPolicy::Reject );
+        }
+
+        inline bool TryEnqueue ( T&& t )
+        {
+            return Put ( std::move ( t ), FullPolicy::Reject );
+        }
+
+        //an element from args in the next slot, unpublished until Commit: constructed in place on the first lap,
+        //assigned to the previous occupant afterwards since lapped cursors may still be reading it. only one
+        //claim may be outstanding. the slot is empty if the buffer is full and P is Reject
+        template<class... Args>
+        inline ClaimedSlot<T> Claim ( Args&& ... args )
+        {
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( !Reserve ( current_head, 1, P ) )
+            {
+                return ClaimedSlot<T>();
+            }
+            return ClaimedSlot<T> ( &buffer.Renew ( current_head & mask, std::forward<Args> ( args )... ), current_head );
+        }
+
+        inline void Commit ( const ClaimedSlot<T>& slot )
+        {
+            head.store ( slot.Position() + 1, std::memory_order_release );
+            waiter.Signal();
+        }
+
+        //copy count elements in and publish them with a single store of head.
+        //the batch is accepted or rejected as a whole
+        inline bool Enqueue ( const T* items, long count )
+        {
+            assert ( count >= 0 && count <= N );
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( !Reserve ( current_head, count, P ) )
+            {
+                return false;
+            }
+            for ( long i = 0; i < count; i++ )
+            {
+                buffer.Assign ( ( current_head + i ) & mask, items[i] );
+            }
+            head.store ( current_head + count, std::memory_order_release );
+            waiter.Signal();
+            return true;
+        }
+
+        //let action fill the slot's previous occupant (default constructed on the first lap)
+        template<class TFunc>
+        inline bool Emplace ( const TFunc& action )
+        {
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( !Reserve ( current_head, 1, P ) )
+            {
+                return false;
+            }
+            action ( buffer.Acquire ( current_head & mask ) );
+            head.store ( current_head + 1, std::memory_order_release );
+            waiter.Signal();
+            return true;
+        }
+
+        //claim count contiguous slots, let action(T* first, long n) fill them (called twice when
+        //the claim wraps around the end of buffer), then publish the whole batch at once
+        template<class TFunc>
+        inline bool EmplaceBatch ( long count, const TFunc& action )
+        {
+            assert ( count >= 0 && count <= N );
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( !Reserve ( current_head, count, P ) )
+            {
+                return false;
+            }
+            long pos = current_head & mask;
+            long first = std::min<long> ( count, N - pos );
+            if ( first > 0 )
+            {
+                action ( buffer.Acquire ( pos, first ), first );
+            }
+            if ( count > first )
+            {
+                action ( buffer.Acquire ( 0, count - first ), count - first );
+            }
+            head.store ( current_head + count, std::memory_order_release );
+            waiter.Signal();
+            return true;
+        }
+
+        inline long GetLatestEntryIndex() const
+        {
+            return head.load ( std::memory_order_acquire ) - 1;
+        }
+
+        inline const T& GetLatestEntryToRead() const
+        {
+            return this->operator[] ( GetLatestEntryIndex() );
+        }
+
+        //only entries that have been published at least once may be read
+        inline const T& operator [] ( long i ) const
+        {
+            return buffer[i & mask];
+        }
+
+        //hand action(const T* first, long n) the entries [first, last) as at most two contiguous spans, split where
+        //the ring wraps. the range must be published and not yet overwritten, e.g. [cursor, GetLatestEntryIndex() + 1)
+        template<class TFunc>
+        inline void Spans ( long first, long last, const TFunc& action ) const
+        {
+            long count = last - first;
+            if ( count <= 0 )
+            {
+                return;
+            }
+            long pos = first & mask;
+            long part = std::min<long> ( count, N - pos );
+            action ( &buffer[pos], part );
+            if ( count > part )
+            {
+                action ( &buffer[0], count - part );
+            }
+        }
+
+        //with P Overwrite (and always for a cursor) the producer may start rewriting a slot while it is read, so
+        //elements are copied out and checked against head before action sees the copy. one that may have been
+        //rewritten is skipped and counted in Overrun()
+        template<class TFunc>
+        inline void Dequeue ( const TFunc& action )
+        {
+            long current_tail = tail.load ( std::memory_order_relaxed );
+            while ( true )
+            {
+                long current_head = head.load ( std::memory_order_acquire );
+                if ( P == FullPolicy::Overwrite )
+                {
+                    current_tail = SkipLapped ( current_tail, current_head );
+                }
+                if ( current_tail >= current_head )
+                {
+                    break;
+                }
+                while ( current_tail < current_head )
+                {
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        Deliver ( current_tail, action );
+                    }
+                    else
+                    {
+                        action ( buffer[current_tail & mask] );
+                    }
+                    current_tail++;
+                }
+                tail.store ( current_tail, std::memory_order_release );
+            }
+        }
+
+        template<class TFunc>
+        inline long Dequeue ( long cursor, const TFunc& action )
+        {
+            while ( true )
+            {
+                long current_head = head.load ( std::memory_order_acquire );
+                cursor = SkipLapped ( cursor, current_head );
+                if ( cursor >= current_head )
+                {
+                    break;
+                }
+                while ( cursor < current_head )
+                {
+                    Deliver ( cursor, action );
+                    cursor++;
+                }
+            }
+            return cursor;
+        }
+
+        //snapshot head once and hand action(T* first, long n) every available element as at most two
+        //contiguous spans (split where the ring wraps), then release them with a single store of tail.
+        //returns the number of elements handed to action. the spans are read in place, so with P Overwrite head
+        //is re-read once action is done: the oldest elements of the batch may have been rewritten while action
+        //read them. how many is stored in *overwritten, if given, and added to Overrun(); the caller throws
+        //those first elements' results away
+        template<class TFunc>
+        inline long DequeueBatch ( const TFunc& action, long* overwritten = nullptr )
+        {
+            long current_tail = tail.load ( std::memory_order_relaxed );
+            long current_head = head.load ( std::memory_order_acquire );
+            long cursor = P == FullPolicy::Overwrite ? SkipLapped ( current_tail, current_head ) : current_tail;
+            long next = DequeueBatch ( cursor, current_head, action );
+            if ( next != current_tail )
+            {
+                tail.store ( next, std::memory_order_release );
+            }
+            long lost = P == FullPolicy::Overwrite ? Overwritten ( cursor, next ) : 0;
+            if ( overwritten != nullptr )
+            {
+                *overwritten = lost;
+            }
+            return next - cursor;
+        }
+
+        //same as above for a reader keeping its own cursor, which the producer never waits for whatever P is.
+        //returns the new cursor
+        template<class TFunc>
+        inline long DequeueBatch ( long cursor, const TFunc& action, long* overwritten = nullptr )
+        {
+            long current_head = head.load ( std::memory_order_acquire );
+            cursor = SkipLapped ( cursor, current_head );
+            long next = DequeueBatch ( cursor, current_head, action );
+            long lost = Overwritten ( cursor, next );
+            if ( overwritten != nullptr )
+            {
+                *overwritten = lost;
+            }
+            return next;
+        }
+
+        //wait up to timeout milliseconds (negative waits forever) according to TWait, then drain like Dequeue.
+        //returns false if nothing arrived in time
+        template<class TFunc>
+        inline bool DequeueWait ( const TFunc& action, int timeout )
+        {
+            auto ready = [this]
+            {
+                return tail.load ( std::memory_order_relaxed ) < head.load ( std::memory_order_acquire );
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return false;
+            }
+            Dequeue ( action );
+            return true;
+        }
+
+        template<class TFunc>
+        inline long DequeueWait ( long cursor, const TFunc& action, int timeout )
+        {
+            auto ready = [this, cursor]
+            {
+                return cursor < head.load ( std::memory_order_acquire );
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return cursor;
+            }
+            return Dequeue ( cursor, action );
+        }
+
+        inline int Size() const
+        {
+            return head.load ( std::memory_order_acquire ) - tail.load ( std::memory_order_acquire );
+        }
+
+        inline void Clear()
+        {
+            head.store ( 0, std::memory_order_relaxed );
+            tail.store ( 0, std::memory_order_relaxed );
+            cached_tail = 0;
+        }
+
+        inline long Capacity() const
+        {
+            return N;
+        }
+
+        //elements refused because the buffer was full
+        inline long Rejected() const
+        {
+            return rejected.load ( std::memory_order_relaxed );
+        }
+
+        //elements overwritten before a reader got to them
+        inline long Overrun() const
+        {
+            return overrun.load ( std::memory_order_relaxed );
+        }
+
+    private:
+        template<class U>
+        inline bool Put ( U&& t, FullPolicy policy )
+        {
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( !Reserve ( current_head, 1, policy ) )
+            {
+                return false;
+            }
+            buffer.Assign ( current_head & mask, std::forward<U> ( t ) );
+            head.store ( current_head + 1, std::memory_order_release );
+            waiter.Signal();
+            return true;
+        }
+
+        //producer side: make room for count elements from current_head according to policy. tail is only
+        //re-read when the cached copy says the buffer is full
+        inline bool Reserve ( long current_head, long count, FullPolicy policy )
+        {
+            if ( policy == FullPolicy::Overwrite || current_head + count - cached_tail <= N )
+            {
+                return true;
+            }
+            while ( true )
+            {
+                cached_tail = tail.load ( std::memory_order_acquire );
+                if ( current_head + count - cached_tail <= N )
+                {
+                    return true;
+                }
+                if ( policy == FullPolicy::Reject )
+                {
+                    rejected.fetch_add ( count, std::memory_order_relaxed );
+                    return false;
+                }
+                concurrent::CpuRelax();
+            }
+        }
+
+        //a reader N elements behind head has been lapped: the slot it is about to read is being rewritten.
+        //move it to the oldest intact element and count the lost ones
+        inline long SkipLapped ( long cursor, long current_head )
+        {
+            if ( current_head - cursor >= N )
+            {
+                long oldest = current_head - N + 1;
+                overrun.fetch_add ( oldest - cursor, std::memory_order_relaxed );
+                return oldest;
+            }
+            return cursor;
+        }
+
+        //the elements of [first, last), already read, that the producer may have been rewriting meanwhile:
+        //those a lap or more behind head as it is now. counts them as lost and returns how many
+        inline long Overwritten ( long first, long last )
+        {
+            std::atomic_thread_fence ( std::memory_order_acquire );
+            long lost = std::min<long> ( last, head.load ( std::memory_order_relaxed ) - N + 1 ) - first;
+            if ( lost <= 0 )
+            {
+                return 0;
+            }
+            overrun.fetch_add ( lost, std::memory_order_relaxed );
+            return lost;
+        }
+
+        //hand action a copy of element index unless it may have been rewritten while being copied
+        template<class TFunc>
+        inline void Deliver ( long index, const TFunc& action )
+        {
+            T copy = buffer[index & mask];
+            if ( Overwritten ( index, index + 1 ) == 0 )
+            {
+                action ( copy );
+            }
+        }
+
+        template<class TFunc>
+        inline long DequeueBatch ( long cursor, long current_head, const TFunc& action )
+        {
+            long count = current_head - cursor;
+            if ( count <= 0 )
+            {
+                return cursor;
+            }
+            long pos = cursor & mask;
+            long first = std::min<long> ( count, N - pos );
+            action ( &buffer[pos], first );
+            if ( count > first )
+            {
+                action ( &buffer[0], count - first );
+            }
+            return current_head;
+        }
+
+        impl::cacheline_pad_t pad0;
+        impl::SlotArray<T, N, TStorage> buffer;
+        impl::cacheline_pad_t pad1;
+        std::atomic_long head;
+        long cached_tail = 0;
+        impl::cacheline_pad_t pad2;
+        std::atomic_long tail;
+        impl::cacheline_pad_t pad3;
+        long mask = N - 1;
+        impl::cacheline_pad_t pad4;
+        TWait waiter;
+        impl::cacheline_pad_t pad5;
+        std::atomic_long rejected;
+        std::atomic_long overrun;
+    };
+
+    template<class T, int N, class TWait = concurrent::BusySpinWait, FullPolicy P = FullPolicy::Overwrite,
+             class TStorage = InlineStorage>
+    class MPSCRingBuffer
+    {
+    public:
+        explicit MPSCRingBuffer ( const memory::Placement& placement = memory::Placement() )
+            : buffer ( placement ), head ( 0 ), tail ( 0 ), buffer_status ( placement ), rejected ( 0 ), overrun ( 0 )
+        {
+            for ( int i = 0 ; i < N; i++ )
+            {
+                buffer_status[i].seq.store ( 0, std::memory_order_relaxed );
+            }
+        }
+
+        static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                        "MPSCRingBuffer's size must be a positive power of 2" );
+
+        //returns false if the element was dropped because the buffer is full and P is Reject
+        inline bool Enqueue ( const T& t )
+        {
+            return Put ( t, P );
+        }
+
+        inline bool Enqueue ( T&& t )
+        {
+            return Put ( std::move ( t ), P );
+        }
+
+        //never overwrites unread elements whatever P is
+        inline bool TryEnqueue ( const T& t )
+        {
+            return Put ( t, FullPolicy::Reject );
+        }
+
+        inline bool TryEnqueue ( T&& t )
+        {
+            return Put ( std::move ( t ), FullPolicy::Reject );
+        }
+
+        //an element from args in a claimed slot, unpublished until Commit: constructed in place on the first
+        //lap, assigned to the previous occupant afterwards since lapped readers may still be reading it. every
+        //producer may hold a claim, the consumer stops at the first uncommitted one. empty if full and P is Reject
+        template<class... Args>
+        inline ClaimedSlot<T> Claim ( Args&& ... args )
+        {
+            long current_head = 0;
+            if ( !Reserve ( current_head, P ) )
+            {
+                return ClaimedSlot<T>();
+            }
+            return ClaimedSlot<T> ( &buffer.Renew ( current_head & mask, std::forward<Args> ( args )... ), current_head );
+        }
+
+        inline void Commit ( const ClaimedSlot<T>& slot )
+        {
+            Publish ( slot.Position() );
+        }
+
+        //let action fill the slot's previous occupant (default constructed on the first lap)
+        template<class TFunc>
+        inline bool Emplace ( const TFunc& action )
+        {
+            long current_head = 0;
+            if ( !Reserve ( current_head, P ) )
+            {
+                return false;
+            }
+            action ( buffer.Acquire ( current_head & mask ) );
+            Publish ( current_head );
+            return true;
+        }
+
+        inline long GetLatestEntryIndex() const
+        {
+            return head - 1;
+        }
+
+        inline const T& GetLatestEntryToRead() const
+        {
+            return this->operator[] ( GetLatestEntryIndex() );
+        }
+
+        //only entries that have been published at least once may be read
+        inline const T& operator [] ( long i ) const
+        {
+            return buffer[i & mask];
+        }
+
+        //with P Overwrite a producer may start rewriting a slot while it is read, so elements are copied out and
+        //the slot's sequence re-read, seqlock style, before action sees the copy. one rewritten meanwhile is
+        //skipped and counted in Overrun()
+        template<class TFunc>
+        inline void Dequeue ( const TFunc& action )
+        {
+            long current_tail = tail.load ( std::memory_order_relaxed );
+            while ( true )
+            {
+                long pos = current_tail & mask;
+                long seq = buffer_status[pos].seq.load ( std::memory_order_acquire );
+                if ( seq == current_tail + 1 )
+                {
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        T copy = buffer[pos];
+                        std::atomic_thread_fence ( std::memory_order_acquire );
+                        if ( buffer_status[pos].seq.load ( std::memory_order_relaxed ) == seq )
+                        {
+                            action ( copy );
+                        }
+                        else
+                        {
+                            overrun.fetch_add ( 1, std::memory_order_relaxed );
+                        }
+                    }
+                    else
+                    {
+                        action ( buffer[pos] );
+                    }
+                    current_tail++;
+                }
+                else if ( seq > current_tail + 1 )
+                {
+                    //the slot already holds a newer element, producers have lapped us
+                    long oldest = std::max ( head.load ( std::memory_order_relaxed ) - N + 1, current_tail + 1 );
+                    overrun.fetch_add ( oldest - current_tail, std::memory_order_relaxed );
+                    current_tail = oldest;
+                }
+                else
+                {
+                    break;
+                }
+                tail.store ( current_tail, std::memory_order_release );
+            }
+        }
+
+        template<class TFunc>
+        inline bool DequeueWait ( const TFunc& action, int timeout )
+        {
+            auto ready = [this]
+            {
+                long current_tail = tail.load ( std::memory_order_relaxed );
+                return buffer_status[current_tail & mask].seq.load ( std::memory_order_acquire ) > current_tail;
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return false;
+            }
+            Dequeue ( action );
+            return true;
         }
 
-        template<class TFunc>
-        inline void Emplace ( const TFunc& action )
+        inline int Size() const
         {
-            using namespace natural_threading;
-            Locker lk ( headlocker );
-            action ( buffer[head & mask] );
-            head++;
+            return head.load ( std::memory_order_acquire ) - tail.load ( std::memory_order_acquire );
         }
 
-        inline long GetLatestEntryIndex() const
+        inline void Clear()
         {
-            return head - 1;
+            head = 0;
+            tail = 0;
+            for ( int i = 0 ; i < N; i++ )
+            {
+                buffer_status[i].seq.store ( 0, std::memory_order_relaxed );
+            }
         }
 
-        inline long GetEndIndex() const
+        inline long Capacity() const
         {
-            return head;
+            return N;
         }
 
-        inline const T& GetLatestEntryToRead() const
+        //elements refused because the buffer was full
+        inline long Rejected() const
         {
-            return this->operator[] ( GetLatestEntryIndex() );
+            return rejected.load ( std::memory_order_relaxed );
         }
 
-        inline const T& operator [] ( long i ) const
+        //elements overwritten before the consumer got to them
+        inline long Overrun() const
         {
-            return buffer[i & mask];
+            return overrun.load ( std::memory_order_relaxed );
         }
 
-        template<class TFunc>
-        inline void Dequeue ( const TFunc& action )
+    private:
+        template<class U>
+        inline bool Put ( U&& t, FullPolicy policy )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
-            while ( true )
+            long current_head = 0;
+            if ( !Reserve ( current_head, policy ) )
             {
-                T* t = nullptr;
-                {
-                    Locker lk ( taillocker );
-                    if ( tail < head )
-                    {
-                        t = & ( buffer[tail & mask] );
-                        tail ++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                action ( *t );
+                return false;
             }
+            buffer.Assign ( current_head & mask, std::forward<U> ( t ) );
+            Publish ( current_head );
+            return true;
         }
 
-        template<class TFunc>
-        inline void Dequeue0 ( const TFunc& action )
+        //claim the next slot. in Overwrite mode a plain fetch_add, otherwise head only moves by CAS while
+        //the consumer is less than N elements behind
+        inline bool Reserve ( long& current_head, FullPolicy policy )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
+            if ( policy == FullPolicy::Overwrite )
+            {
+                current_head = head++;
+                Handover ( current_head );
+                return true;
+            }
+            current_head = head.load ( std::memory_order_relaxed );
             while ( true )
             {
-                T* t = nullptr;
+                if ( current_head - tail.load ( std::memory_order_acquire ) >= N )
                 {
-                    if ( tail < head )
-                    {
-                        t = & ( buffer[tail & mask] );
-                        tail ++;
-                    }
-                    else
+                    if ( policy == FullPolicy::Reject )
                     {
-                        break;
+                        rejected.fetch_add ( 1, std::memory_order_relaxed );
+                        return false;
                     }
+                    concurrent::CpuRelax();
+                    current_head = head.load ( std::memory_order_relaxed );
+                }
+                else if ( head.compare_exchange_weak ( current_head, current_head + 1, std::memory_order_relaxed ) )
+                {
+                    Handover ( current_head );
+                    return true;
                 }
-                action ( *t );
             }
         }
 
-        template<class TFunc>
-        inline long Dequeue ( long cursor, const TFunc& action )
+        //with P Overwrite the consumer may skip elements that are still being written, and producers a lap
+        //apart get the same slot: wait until the slot's previous element is published (its status holds that
+        //sequence + 1, or 0 on the first lap), then mark the slot Writing before touching it, so a reader
+        //re-checking the status after reading sees it change
+        inline void Handover ( long current_head )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
-            while ( true )
+            if ( P != FullPolicy::Overwrite )
             {
-                T* t = nullptr;
-                {
-                    if ( cursor < head )
-                    {
-                        t = & ( buffer[cursor & mask] );
-                        cursor ++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                action ( *t );
+                return;
             }
-            return cursor;
+            std::atomic_long& seq = buffer_status[current_head & mask].seq;
+            long previous = std::max<long> ( current_head - N + 1, 0 );
+            while ( seq.load ( std::memory_order_acquire ) != previous )
+            {
+                concurrent::CpuRelax();
+            }
+            seq.store ( Writing, std::memory_order_relaxed );
+            std::atomic_thread_fence ( std::memory_order_release );
         }
 
-        inline int Size() const
+        //a slot is readable for sequence s once its status holds s + 1
+        inline void Publish ( long current_head )
         {
-            return head - tail;
+            buffer_status[current_head & mask].seq.store ( current_head + 1, std::memory_order_release );
+            waiter.Signal();
         }
 
-        inline void Clear()
+        struct Status
         {
-            head = 0;
-            tail = 0;
-        }
+            std::atomic_long seq;
+        };
 
-        inline long Capacity() const
-        {
-            return N;
-        }
+        static constexpr long Writing = -1;
 
-    private:
         impl::cacheline_pad_t pad0;
-        std::array<T, N> buffer;
+        impl::SlotArray<T, N, TStorage> buffer;
         impl::cacheline_pad_t pad1;
-        volatile long head = 0;
+        std::atomic_long head ;
         impl::cacheline_pad_t pad2;
-        volatile long tail = 0;
+        std::atomic_long tail;
         impl::cacheline_pad_t pad3;
         long mask = N - 1;
-        folly::RWSpinLock headlocker;
         impl::cacheline_pad_t pad4;
-        folly::RWSpinLock taillocker;
+        impl::ValueArray<Status, N, TStorage> buffer_status;
         impl::cacheline_pad_t pad5;
+        TWait waiter;
+        impl::cacheline_pad_t pad6;
+        std::atomic_long rejected;
+        std::atomic_long overrun;
     };
 
-    template<class T, int N>
-    class SPSCRingBuffer
+    template<class T, int N, class TWait = concurrent::BusySpinWait, class TStorage = InlineStorage>
+    class MPMCRingBuffer
     {
     public:
-        SPSCRingBuffer()
+        //message queue only: every cursor sees every element. use MPMCWorkQueue for competing consumers
+        explicit MPMCRingBuffer ( const memory::Placement& placement = memory::Placement() )
+            : buffer ( placement ), head ( 0 ), buffer_status ( placement )
         {
+            shift = std::log2 ( N );
+            for ( int i = 0 ; i < N; i++ )
+            {
+                buffer_status[i].seq = i;
+            }
         }
 
         static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
-                        "SPSCRingBuffer's size must be a positive power of 2" );
+                        "MPMCRingBuffer's size must be a positive power of 2" );
 
         inline void Enqueue ( const T& t )
         {
-            using namespace natural_threading;
-            buffer[head & mask] = t;
-            head++;
+            Put ( t );
+        }
+
+        inline void Enqueue ( T&& t )
+        {
+            Put ( std::move ( t ) );
+        }
+
+        //an element from args in a claimed slot, unpublished until Commit: constructed in place on the first
+        //lap, assigned to the previous occupant afterwards since lapped cursors may still be reading it
+        template<class... Args>
+        inline ClaimedSlot<T> Claim ( Args&& ... args )
+        {
+            long current_head = head++;
+            return ClaimedSlot<T> ( &buffer.Renew ( current_head & mask, std::forward<Args> ( args )... ), current_head );
+        }
+
+        inline void Commit ( const ClaimedSlot<T>& slot )
+        {
+            buffer_status[slot.Position() & mask].seq = slot.Position() + N;
+            waiter.Signal();
         }
 
+        //let action fill the slot's previous occupant (default constructed on the first lap)
         template<class TFunc>
         inline void Emplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            action ( buffer[head & mask] );
-            head++;
+            using namespace concurrent;
+            long current_head = head++;
+            long pos = current_head & mask;
+            action ( buffer.Acquire ( pos ) );
+            buffer_status[pos].seq = current_head + N;
+            waiter.Signal();
         }
 
         inline long GetLatestEntryIndex() const
@@ -315,24 +1776,25 @@ public:
             return this->operator[] ( GetLatestEntryIndex() );
         }
 
+        //only entries that have been published at least once may be read
         inline const T& operator [] ( long i ) const
         {
             return buffer[i & mask];
         }
 
-
         template<class TFunc>
-        inline void Dequeue ( const TFunc& action )
+        inline void Dequeue0 ( const TFunc& action )
         {
-            using namespace natural_threading;
+            using namespace concurrent;
             //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
             while ( true )
             {
                 T* t = nullptr;
                 {
-                    if ( tail < head )
+                    long pos = tail & mask;
+                    if ( tail < buffer_status[pos].seq )
                     {
-                        t = & ( buffer[tail & mask] );
+                        t = & ( buffer[pos] );
                         tail ++;
                     }
                     else
@@ -347,15 +1809,16 @@ public:
         template<class TFunc>
         inline long Dequeue ( long cursor, const TFunc& action )
         {
-            using namespace natural_threading;
+            using namespace concurrent;
             //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
             while ( true )
             {
                 T* t = nullptr;
                 {
-                    if ( cursor < head )
+                    long pos = cursor & mask;
+                    if ( cursor < buffer_status[pos].seq )
                     {
-                        t = & ( buffer[cursor & mask] );
+                        t = & ( buffer[pos] );
                         cursor ++;
                     }
                     else
@@ -368,6 +1831,35 @@ public:
             return cursor;
         }
 
+        template<class TFunc>
+        inline bool DequeueWait ( const TFunc& action, int timeout )
+        {
+            auto ready = [this]
+            {
+                return tail < buffer_status[tail & mask].seq;
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return false;
+            }
+            Dequeue0 ( action );
+            return true;
+        }
+
+        template<class TFunc>
+        inline long DequeueWait ( long cursor, const TFunc& action, int timeout )
+        {
+            auto ready = [this, cursor]
+            {
+                return cursor < buffer_status[cursor & mask].seq;
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return cursor;
+            }
+            return Dequeue ( cursor, action );
+        }
+
         inline int Size() const
         {
             return head - tail;
@@ -377,6 +1869,10 @@ public:
         {
             head = 0;
             tail = 0;
+            for ( int i = 0 ; i < N; i++ )
+            {
+                buffer_status[i].seq = i;
+            }
         }
 
         inline long Capacity() const
@@ -385,167 +1881,455 @@ public:
         }
 
     private:
+        template<class U>
+        inline void Put ( U&& t )
+        {
+            long current_head = head++;
+            long pos = current_head & mask;
+            buffer.Assign ( pos, std::forward<U> ( t ) );
+            buffer_status[pos].seq = current_head + N;
+            waiter.Signal();
+        }
+
+        struct Status
+        {
+            volatile long seq = 0;
+        };
+
         impl::cacheline_pad_t pad0;
-        std::array<T, N> buffer;
+        impl::SlotArray<T, N, TStorage> buffer;
         impl::cacheline_pad_t pad1;
-        volatile long head = 0;
+        std::atomic_long head ;
         impl::cacheline_pad_t pad2;
         volatile long tail = 0;
         impl::cacheline_pad_t pad3;
         long mask = N - 1;
+        long shift = 0;
         impl::cacheline_pad_t pad4;
+        impl::ValueArray<Status, N, TStorage> buffer_status;
+        impl::cacheline_pad_t pad5;
+        TWait waiter;
+        impl::cacheline_pad_t pad6;
     };
 
-    template<class T, int N>
-    class MPSCRingBuffer
+    //bounded MPMC work queue after Dmitry Vyukov: competing consumers, every element is taken by exactly
+    //one of them. each cell carries a sequence number so producers detect a full queue and consumers an
+    //empty one without locks, head and tail are claimed with CAS
+    template<class T, int N, class TWait = concurrent::BusySpinWait>
+    class MPMCWorkQueue
     {
     public:
-        MPSCRingBuffer() : head ( 0 )
+        MPMCWorkQueue() : head ( 0 ), tail ( 0 )
+        {
+            for ( int i = 0 ; i < N; i++ )
+            {
+                cells[i].seq.store ( i, std::memory_order_relaxed );
+            }
+        }
+
+        ~MPMCWorkQueue()
         {
+            for ( auto& cell : cells )
+            {
+                cell.Destroy();
+            }
         }
 
         static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
-                        "MPSCRingBuffer's size must be a positive power of 2" );
+                        "MPMCWorkQueue's size must be a positive power of 2" );
 
-        inline void Enqueue ( const T& t )
+        //returns false when the queue is full
+        inline bool TryEnqueue ( const T& t )
+        {
+            return TryPut ( t );
+        }
+
+        inline bool TryEnqueue ( T&& t )
         {
-            using namespace natural_threading;
-            long pos = head++ & mask;;
-            buffer[pos] = t;
-            buffer_status[pos].seq = true;
+            return TryPut ( std::move ( t ) );
         }
 
+        //let action fill the cell's previous occupant (default constructed on the first lap)
         template<class TFunc>
-        inline void Emplace ( const TFunc& action )
+        inline bool TryEmplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            long pos = head++ & mask;
-            action ( buffer[pos] );
-            buffer_status[pos].seq = true;
+            long pos = 0;
+            if ( !ClaimPosition ( pos ) )
+            {
+                return false;
+            }
+            action ( cells[pos & mask].Acquire() );
+            Publish ( pos );
+            return true;
         }
 
-        inline long GetLatestEntryIndex() const
+        //spin until there is room
+        inline void Enqueue ( const T& t )
         {
-            return head - 1;
+            while ( !TryPut ( t ) )
+            {
+                concurrent::CpuRelax();
+            }
         }
 
-        inline const T& GetLatestEntryToRead() const
+        //t is only moved from once it has been accepted
+        inline void Enqueue ( T&& t )
         {
-            return this->operator[] ( GetLatestEntryIndex() );
+            while ( !TryPut ( std::move ( t ) ) )
+            {
+                concurrent::CpuRelax();
+            }
         }
 
-        inline const T& operator [] ( long i ) const
+        //construct an element from args in place in a claimed cell, unpublished until Commit.
+        //empty when the queue is full
+        template<class... Args>
+        inline ClaimedSlot<T> TryClaim ( Args&& ... args )
         {
-            return buffer[i & mask];
+            long pos = 0;
+            if ( !ClaimPosition ( pos ) )
+            {
+                return ClaimedSlot<T>();
+            }
+            return ClaimedSlot<T> ( &cells[pos & mask].Construct ( std::forward<Args> ( args )... ), pos );
+        }
+
+        //spin until there is room
+        template<class... Args>
+        inline ClaimedSlot<T> Claim ( Args&& ... args )
+        {
+            long pos = 0;
+            while ( !ClaimPosition ( pos ) )
+            {
+                concurrent::CpuRelax();
+            }
+            return ClaimedSlot<T> ( &cells[pos & mask].Construct ( std::forward<Args> ( args )... ), pos );
+        }
+
+        inline void Commit ( const ClaimedSlot<T>& slot )
+        {
+            Publish ( slot.Position() );
         }
 
         template<class TFunc>
-        inline void Dequeue ( const TFunc& action )
+        inline void Emplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
+            while ( !TryEmplace ( action ) )
+            {
+                concurrent::CpuRelax();
+            }
+        }
+
+        //take one element, returns false when the queue is empty
+        template<class TFunc>
+        inline bool TryDequeue ( const TFunc& action )
+        {
+            Cell* cell = nullptr;
+            long pos = tail.load ( std::memory_order_relaxed );
             while ( true )
             {
-                T* t = nullptr;
+                cell = &cells[pos & mask];
+                long diff = cell->seq.load ( std::memory_order_acquire ) - ( pos + 1 );
+                if ( diff == 0 )
                 {
-                    long pos = tail & mask;
-                    if ( buffer_status[pos].seq )
+                    if ( tail.compare_exchange_weak ( pos, pos + 1, std::memory_order_relaxed ) )
                     {
-                        t = & ( buffer[pos] );
-                        if ( head - ( tail++ ) < N )
-                        {
-                            buffer_status[pos].seq = false;
-                        }
+                        break;
                     }
-                    else
+                }
+                else if ( diff < 0 )
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = tail.load ( std::memory_order_relaxed );
+                }
+            }
+            action ( cell->Value() );
+            cell->seq.store ( pos + N, std::memory_order_release );
+            return true;
+        }
+
+        inline bool TryDequeue ( T& t )
+        {
+            return TryDequeue ( [&t] ( T & value )
+            {
+                t = std::move ( value );
+            } );
+        }
+
+        //take elements until the queue looks empty, returns the number taken
+        template<class TFunc>
+        inline long Dequeue ( const TFunc& action )
+        {
+            long count = 0;
+            while ( TryDequeue ( action ) )
+            {
+                count++;
+            }
+            return count;
+        }
+
+        template<class TFunc>
+        inline bool DequeueWait ( const TFunc& action, int timeout )
+        {
+            auto ready = [this]
+            {
+                long pos = tail.load ( std::memory_order_relaxed );
+                return cells[pos & mask].seq.load ( std::memory_order_acquire ) == pos + 1;
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return false;
+            }
+            return Dequeue ( action ) > 0;
+        }
+
+        inline int Size() const
+        {
+            return head.load ( std::memory_order_acquire ) - tail.load ( std::memory_order_acquire );
+        }
+
+        inline long Capacity() const
+        {
+            return N;
+        }
+
+    private:
+        //take the next position for a producer, false when the queue is full
+        inline bool ClaimPosition ( long& pos )
+        {
+            pos = head.load ( std::memory_order_relaxed );
+            while ( true )
+            {
+                long diff = cells[pos & mask].seq.load ( std::memory_order_acquire ) - pos;
+                if ( diff == 0 )
+                {
+                    if ( head.compare_exchange_weak ( pos, pos + 1, std::memory_order_relaxed ) )
                     {
-                        break;
+                        return true;
                     }
                 }
-                action ( *t );
+                else if ( diff < 0 )
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = head.load ( std::memory_order_relaxed );
+                }
             }
         }
 
-        inline int Size() const
+        inline void Publish ( long pos )
         {
-            return head - tail;
+            cells[pos & mask].seq.store ( pos + 1, std::memory_order_release );
+            waiter.Signal();
         }
 
-        inline void Clear()
+        template<class U>
+        inline bool TryPut ( U&& t )
         {
-            head = 0;
-            tail = 0;
+            long pos = 0;
+            if ( !ClaimPosition ( pos ) )
+            {
+                return false;
+            }
+            cells[pos & mask].Assign ( std::forward<U> ( t ) );
+            Publish ( pos );
+            return true;
         }
 
-        inline long Capacity() const
+        //sequence and element sit together in a cell, so a hand off touches the lines of one cell only, and a
+        //cache line of padding keeps threads working on neighbouring cells from sharing any. padding rather than
+        //alignas, which plain new does not honour before C++17. the element is built in place on first use
+        struct Cell
         {
-            return N;
-        }
+            std::atomic_long seq;
+            bool live = false;
+            typename std::aligned_storage<sizeof ( T ), alignof ( T )>::type storage;
+            impl::cacheline_pad_t pad;
 
-    private:
-        struct Status
-        {
-            volatile bool seq = false;
+            inline T& Value()
+            {
+                return *reinterpret_cast<T*> ( &storage );
+            }
+
+            template<class... Args>
+            inline T& Construct ( Args&& ... args )
+            {
+                Destroy();
+                T* t = new ( &storage ) T ( std::forward<Args> ( args )... );
+                live = true;
+                return *t;
+            }
+
+            template<class U>
+            inline T& Assign ( U&& value )
+            {
+                if ( !live )
+                {
+                    return Construct ( std::forward<U> ( value ) );
+                }
+                T& t = Value();
+                t = std::forward<U> ( value );
+                return t;
+            }
+
+            inline T& Acquire()
+            {
+                return live ? Value() : Construct();
+            }
+
+            inline void Destroy()
+            {
+                if ( live )
+                {
+                    Value().~T();
+                    live = false;
+                }
+            }
         };
 
         impl::cacheline_pad_t pad0;
-        std::array<T, N> buffer;
+        std::array<Cell, N> cells;
         impl::cacheline_pad_t pad1;
-        std::atomic_long head ;
+        std::atomic_long head;
         impl::cacheline_pad_t pad2;
-        volatile long tail = 0;
+        std::atomic_long tail;
         impl::cacheline_pad_t pad3;
         long mask = N - 1;
         impl::cacheline_pad_t pad4;
-        std::array<Status, N> buffer_status;
+        TWait waiter;
         impl::cacheline_pad_t pad5;
     };
 
-    template<class T, int N>
-    class MPMCRingBuffer
+    //Disruptor style broadcast ring: one producer and up to R registered readers, each seeing every element
+    //through its own padded sequence instead of a copy per reader. the producer never overruns the slowest
+    //registered reader, and a reader registered with upstream readers only sees entries they have finished
+    template<class T, int N, int R = 16, class TWait = concurrent::BusySpinWait>
+    class BroadcastRingBuffer
     {
     public:
-        //only implement message queue. there is no need for working queue at present
-        MPMCRingBuffer() : head ( 0 )
+        class Reader
         {
-            shift = std::log2 ( N );
-            for ( int i = 0 ; i < N; i++ )
+        public:
+            //sequence of the next element this reader will see
+            inline long Cursor() const
             {
-                buffer_status[i].seq = i;
+                return sequence.load ( std::memory_order_acquire );
+            }
+
+        private:
+            friend class BroadcastRingBuffer;
+            impl::cacheline_pad_t pad0;
+            std::atomic_long sequence;
+            std::atomic_bool active;
+            impl::cacheline_pad_t pad1;
+            std::array<const Reader*, R> upstream;
+            int upstream_count = 0;
+        };
+
+        BroadcastRingBuffer() : head ( 0 ), reader_count ( 0 )
+        {
+            for ( auto& reader : readers )
+            {
+                reader.sequence.store ( 0, std::memory_order_relaxed );
+                reader.active.store ( false, std::memory_order_relaxed );
             }
         }
 
         static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
-                        "MPMCRingBuffer's size must be a positive power of 2" );
+                        "BroadcastRingBuffer's size must be a positive power of 2" );
+
+        //register a reader starting at the next published element, gated by the given upstream readers.
+        //readers may be added while the producer runs, but only from one thread at a time.
+        //returns nullptr once R readers are registered
+        inline Reader* AddReader ( std::initializer_list<const Reader*> dependencies = {} )
+        {
+            int index = reader_count.load ( std::memory_order_relaxed );
+            if ( index >= R )
+            {
+                return nullptr;
+            }
+            Reader& reader = readers[index];
+            reader.upstream_count = 0;
+            for ( const Reader* dependency : dependencies )
+            {
+                reader.upstream[reader.upstream_count++] = dependency;
+            }
+            //publish the reader before picking its start, as the Disruptor adds a gating sequence: a producer
+            //that refreshes its gate without seeing the reader yet has published no further than the head read
+            //after the fence, so it cannot lap the start
+            reader.sequence.store ( Start ( reader ), std::memory_order_relaxed );
+            reader.active.store ( true, std::memory_order_release );
+            reader_count.store ( index + 1, std::memory_order_release );
+            std::atomic_thread_fence ( std::memory_order_seq_cst );
+            reader.sequence.store ( Start ( reader ), std::memory_order_release );
+            return &reader;
+        }
+
+        //stop gating the producer on this reader. readers depending on it keep the position it stopped at
+        inline void RemoveReader ( Reader* reader )
+        {
+            reader->active.store ( false, std::memory_order_release );
+        }
 
         inline void Enqueue ( const T& t )
         {
-            using namespace natural_threading;
+            long current_head = Claim ( 1 );
+            buffer[current_head & mask] = t;
+            Publish ( current_head + 1 );
+        }
 
-            long current_head = head++;
-            long pos = current_head & mask;
-            buffer[pos] = t;
-            buffer_status[pos].seq = current_head + N;
+        //returns false instead of waiting when the slowest reader is N elements behind
+        inline bool TryEnqueue ( const T& t )
+        {
+            long current_head = head.load ( std::memory_order_relaxed );
+            if ( current_head + 1 - cached_gate > N )
+            {
+                cached_gate = MinSequence ( current_head );
+                if ( current_head + 1 - cached_gate > N )
+                {
+                    return false;
+                }
+            }
+            buffer[current_head & mask] = t;
+            Publish ( current_head + 1 );
+            return true;
         }
 
         template<class TFunc>
         inline void Emplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            long current_head = head++;
-            long pos = current_head & mask;
-            action ( buffer[pos] );
-            buffer_status[pos].seq = current_head + N;
+            long current_head = Claim ( 1 );
+            action ( buffer[current_head & mask] );
+            Publish ( current_head + 1 );
         }
 
-        inline long GetLatestEntryIndex() const
+        //same contract as SPSCRingBuffer::EmplaceBatch
+        template<class TFunc>
+        inline void EmplaceBatch ( long count, const TFunc& action )
         {
-            return head - 1;
+            assert ( count >= 0 && count <= N );
+            long current_head = Claim ( count );
+            long pos = current_head & mask;
+            long first = std::min<long> ( count, N - pos );
+            if ( first > 0 )
+            {
+                action ( &buffer[pos], first );
+            }
+            if ( count > first )
+            {
+                action ( &buffer[0], count - first );
+            }
+            Publish ( current_head + count );
         }
 
-        inline const T& GetLatestEntryToRead() const
+        inline long GetLatestEntryIndex() const
         {
-            return this->operator[] ( GetLatestEntryIndex() );
+            return head.load ( std::memory_order_acquire ) - 1;
         }
 
         inline const T& operator [] ( long i ) const
@@ -553,68 +2337,70 @@ public:
             return buffer[i & mask];
         }
 
+        //hand reader every element available to it, returns the number read
         template<class TFunc>
-        inline void Dequeue0 ( const TFunc& action )
+        inline long Dequeue ( Reader* reader, const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
-            while ( true )
+            long cursor = reader->sequence.load ( std::memory_order_relaxed );
+            long available = Available ( reader );
+            for ( long i = cursor; i < available; i++ )
             {
-                T* t = nullptr;
-                {
-                    long pos = tail & mask;
-                    if ( tail < buffer_status[pos].seq )
-                    {
-                        t = & ( buffer[pos] );
-                        tail ++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                action ( *t );
+                action ( buffer[i & mask] );
+            }
+            if ( available > cursor )
+            {
+                reader->sequence.store ( available, std::memory_order_release );
             }
+            return available - cursor;
         }
 
+        //same as Dequeue, with the elements handed to action(T* first, long n) as at most two contiguous spans
         template<class TFunc>
-        inline long Dequeue ( long cursor, const TFunc& action )
+        inline long DequeueBatch ( Reader* reader, const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
-            while ( true )
+            long cursor = reader->sequence.load ( std::memory_order_relaxed );
+            long count = Available ( reader ) - cursor;
+            if ( count <= 0 )
             {
-                T* t = nullptr;
-                {
-                    long pos = cursor & mask;
-                    if ( cursor < buffer_status[pos].seq )
-                    {
-                        t = & ( buffer[pos] );
-                        cursor ++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                action ( *t );
+                return 0;
             }
-            return cursor;
+            long pos = cursor & mask;
+            long first = std::min<long> ( count, N - pos );
+            action ( &buffer[pos], first );
+            if ( count > first )
+            {
+                action ( &buffer[0], count - first );
+            }
+            reader->sequence.store ( cursor + count, std::memory_order_release );
+            return count;
         }
 
-        inline int Size() const
+        //upstream readers do not signal, so a dependent reader using BlockingWait only wakes on new elements
+        //or timeout; give dependent readers a spinning strategy or a short timeout
+        template<class TFunc>
+        inline long DequeueWait ( Reader* reader, const TFunc& action, int timeout )
         {
-            return head - tail;
+            auto ready = [this, reader]
+            {
+                return Available ( reader ) > reader->sequence.load ( std::memory_order_relaxed );
+            };
+            if ( !waiter.Wait ( ready, timeout ) )
+            {
+                return 0;
+            }
+            return Dequeue ( reader, action );
         }
 
-        inline void Clear()
+        inline int ReaderCount() const
         {
-            head = 0;
-            tail = 0;
-            for ( int i = 0 ; i < N; i++ )
-            {
-                buffer_status[i].seq = i;
-            }
+            return reader_count.load ( std::memory_order_acquire );
+        }
+
+        //distance between the producer and the slowest registered reader
+        inline int Size() const
+        {
+            long current_head = head.load ( std::memory_order_acquire );
+            return current_head - MinSequence ( current_head );
         }
 
         inline long Capacity() const
@@ -623,51 +2409,134 @@ public:
         }
 
     private:
-        struct Status
+        inline long Available ( const Reader* reader ) const
         {
-            volatile long seq = 0;
-        };
+            long available = head.load ( std::memory_order_acquire );
+            for ( int i = 0; i < reader->upstream_count; i++ )
+            {
+                available = std::min ( available, reader->upstream[i]->sequence.load ( std::memory_order_acquire ) );
+            }
+            return available;
+        }
+
+        //the next published element, or the oldest one an upstream reader has yet to finish
+        inline long Start ( const Reader& reader ) const
+        {
+            long start = head.load ( std::memory_order_acquire );
+            for ( int i = 0; i < reader.upstream_count; i++ )
+            {
+                start = std::min ( start, reader.upstream[i]->Cursor() );
+            }
+            return start;
+        }
+
+        //pairs with the fence in AddReader: either the reader is seen here or it starts after current_head
+        inline long MinSequence ( long current_head ) const
+        {
+            long gate = current_head;
+            std::atomic_thread_fence ( std::memory_order_seq_cst );
+            int count = reader_count.load ( std::memory_order_acquire );
+            for ( int i = 0; i < count; i++ )
+            {
+                if ( readers[i].active.load ( std::memory_order_acquire ) )
+                {
+                    gate = std::min ( gate, readers[i].sequence.load ( std::memory_order_acquire ) );
+                }
+            }
+            return gate;
+        }
+
+        //wait until count slots from head are no longer needed by any reader
+        inline long Claim ( long count )
+        {
+            long current_head = head.load ( std::memory_order_relaxed );
+            while ( current_head + count - cached_gate > N )
+            {
+                cached_gate = MinSequence ( current_head );
+                if ( current_head + count - cached_gate > N )
+                {
+                    concurrent::CpuRelax();
+                }
+            }
+            return current_head;
+        }
+
+        inline void Publish ( long next )
+        {
+            head.store ( next, std::memory_order_release );
+            waiter.Signal();
+        }
 
         impl::cacheline_pad_t pad0;
         std::array<T, N> buffer;
         impl::cacheline_pad_t pad1;
-        std::atomic_long head ;
+        std::atomic_long head;
+        long cached_gate = 0;
         impl::cacheline_pad_t pad2;
-        volatile long tail = 0;
-        impl::cacheline_pad_t pad3;
         long mask = N - 1;
-        long shift = 0;
+        std::atomic_int reader_count;
+        impl::cacheline_pad_t pad3;
+        std::array<Reader, R> readers;
         impl::cacheline_pad_t pad4;
-        std::array<Status, N> buffer_status;
+        TWait waiter;
         impl::cacheline_pad_t pad5;
     };
 
-    template<class T, int N>
+    template<class T, int N, FullPolicy P = FullPolicy::Overwrite, class TLock = concurrent::RWSpinLock,
+             class TStorage = InlineStorage>
     class CircularArray
     {
     public:
-        CircularArray()
+        explicit CircularArray ( const memory::Placement& placement = memory::Placement() )
+            : buffer ( placement ), rejected ( 0 ), overrun ( 0 )
         {
         }
 
         static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
                         "CircularArray's size must be a positive power of 2" );
 
-        inline void Enqueue ( const T& t )
+        typedef T value_type;
+
+        //returns false if the element was dropped because the buffer is full and P is Reject
+        inline bool Enqueue ( const T& t )
         {
-            using namespace natural_threading;
-            Locker lk ( headlocker );
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( P ) )
+            {
+                return false;
+            }
+            buffer[head & mask] = t;
+            head++;
+            return true;
+        }
+
+        //never overwrites unread elements whatever P is
+        inline bool TryEnqueue ( const T& t )
+        {
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( FullPolicy::Reject ) )
+            {
+                return false;
+            }
             buffer[head & mask] = t;
             head++;
+            return true;
         }
 
         template<class TFunc>
-        inline void Emplace ( const TFunc& action )
+        inline bool Emplace ( const TFunc& action )
         {
-            using namespace natural_threading;
-            Locker lk ( headlocker );
+            using namespace concurrent;
+            BasicLocker<TLock> lk ( headlocker );
+            if ( !Reserve ( P ) )
+            {
+                return false;
+            }
             action ( buffer[head & mask] );
             head++;
+            return true;
         }
 
         inline long GetLatestEntryIndex() const
@@ -685,18 +2554,45 @@ public:
             return buffer[i & mask];
         }
 
+        //hand action(const T* first, long n) the entries [first, last) as at most two contiguous spans, split where
+        //the ring wraps. the range must be published and not yet overwritten, e.g. [cursor, GetLatestEntryIndex() + 1)
+        template<class TFunc>
+        inline void Spans ( long first, long last, const TFunc& action ) const
+        {
+            long count = last - first;
+            if ( count <= 0 )
+            {
+                return;
+            }
+            long pos = first & mask;
+            long part = std::min<long> ( count, N - pos );
+            action ( &buffer[pos], part );
+            if ( count > part )
+            {
+                action ( &buffer[0], count - part );
+            }
+        }
+
+        //with P Overwrite (and always for a cursor) a producer may start rewriting a slot while it is read, so
+        //elements are copied out and checked against head before action sees the copy. one that may have been
+        //rewritten is skipped and counted in Overrun()
         template<class TFunc>
         inline void Dequeue ( const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
+            using namespace concurrent;
             while ( true )
             {
                 T* t = nullptr;
+                long index = 0;
                 {
-                    Locker lk ( taillocker );
+                    BasicLocker<TLock> lk ( taillocker );
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        tail = SkipLapped ( tail );
+                    }
                     if ( tail < head )
                     {
+                        index = tail;
                         t = & ( buffer[tail & mask] );
                         tail ++;
                     }
@@ -705,21 +2601,33 @@ public:
                         break;
                     }
                 }
-                action ( *t );
+                if ( P == FullPolicy::Overwrite )
+                {
+                    Deliver ( index, action );
+                }
+                else
+                {
+                    action ( *t );
+                }
             }
         }
 
         template<class TFunc>
         inline void Dequeue0 ( const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
+            using namespace concurrent;
             while ( true )
             {
                 T* t = nullptr;
+                long index = 0;
                 {
+                    if ( P == FullPolicy::Overwrite )
+                    {
+                        tail = SkipLapped ( tail );
+                    }
                     if ( tail < head )
                     {
+                        index = tail;
                         t = & ( buffer[tail & mask] );
                         tail ++;
                     }
@@ -728,30 +2636,30 @@ public:
                         break;
                     }
                 }
-                action ( *t );
+                if ( P == FullPolicy::Overwrite )
+                {
+                    Deliver ( index, action );
+                }
+                else
+                {
+                    action ( *t );
+                }
             }
         }
 
         template<class TFunc>
         inline long Dequeue ( long cursor, const TFunc& action )
         {
-            using namespace natural_threading;
-            //assume N is big enough and action is fast enough, so that element will not be overwrite after pop up;
+            using namespace concurrent;
             while ( true )
             {
-                T* t = nullptr;
+                cursor = SkipLapped ( cursor );
+                if ( cursor >= head )
                 {
-                    if ( cursor < head )
-                    {
-                        t = & ( buffer[cursor & mask] );
-                        cursor ++;
-                    }
-                    else
-                    {
-                        break;
-                    }
+                    break;
                 }
-                action ( *t );
+                Deliver ( cursor, action );
+                cursor ++;
             }
             return cursor;
         }
@@ -772,25 +2680,95 @@ public:
             return N;
         }
 
+        //elements refused because the buffer was full
+        inline long Rejected() const
+        {
+            return rejected.load ( std::memory_order_relaxed );
+        }
+
+        //elements overwritten before a reader got to them
+        inline long Overrun() const
+        {
+            return overrun.load ( std::memory_order_relaxed );
+        }
+
     private:
+        //called with headlocker held. tail is only read, so consumers never wait for producers
+        inline bool Reserve ( FullPolicy policy )
+        {
+            if ( policy == FullPolicy::Overwrite )
+            {
+                return true;
+            }
+            while ( head - tail >= N )
+            {
+                if ( policy == FullPolicy::Reject )
+                {
+                    rejected.fetch_add ( 1, std::memory_order_relaxed );
+                    return false;
+                }
+                concurrent::CpuRelax();
+            }
+            return true;
+        }
+
+        //a reader N elements behind head has been lapped: the slot it is about to read is being rewritten.
+        //move it to the oldest intact element and count the lost ones
+        inline long SkipLapped ( long cursor )
+        {
+            long current_head = head;
+            if ( current_head - cursor >= N )
+            {
+                long oldest = current_head - N + 1;
+                overrun.fetch_add ( oldest - cursor, std::memory_order_relaxed );
+                return oldest;
+            }
+            return cursor;
+        }
+
+        //the same check once element index has been read, seqlock style: head reaching a lap past it means a
+        //producer may have been rewriting the slot during the read. the element counts as lost
+        inline bool Overwritten ( long index )
+        {
+            std::atomic_thread_fence ( std::memory_order_acquire );
+            if ( head - index >= N )
+            {
+                overrun.fetch_add ( 1, std::memory_order_relaxed );
+                return true;
+            }
+            return false;
+        }
+
+        //hand action a copy of element index unless it may have been rewritten while being copied
+        template<class TFunc>
+        inline void Deliver ( long index, const TFunc& action )
+        {
+            T copy = buffer[index & mask];
+            if ( !Overwritten ( index ) )
+            {
+                action ( copy );
+            }
+        }
+
         impl::cacheline_pad_t pad0;
-        std::array<T, N> buffer;
+        impl::ValueArray<T, N, TStorage> buffer;
         impl::cacheline_pad_t pad1;
         volatile long head = 0;
         impl::cacheline_pad_t pad2;
         volatile long tail = 0;
         impl::cacheline_pad_t pad3;
         long mask = N - 1;
-        folly::RWSpinLock headlocker;
+        TLock headlocker;
         impl::cacheline_pad_t pad4;
-        folly::RWSpinLock taillocker;
+        TLock taillocker;
         impl::cacheline_pad_t pad5;
+        std::atomic_long rejected;
+        std::atomic_long overrun;
     };
 
 
 }
 }
-}
 
 
 
@@ -0,0 +1,301 @@
+#ifndef LIBTRADE_ENGINE_H
+#define LIBTRADE_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "container.h"
+#include "hashmap.h"
+#include "runtime.h"
+
+namespace trade
+{
+namespace concurrent
+{
+//what a shard has done, counted by its own thread
+struct ShardStats
+{
+    uint64_t messages = 0; // handled
+    uint64_t batches = 0; // polls that found something
+    uint64_t idle = 0; // polls that found nothing
+    long pending = 0; // posted and not yet handled
+    long rejected = 0; // refused by TryPost, the inbox was full
+};
+
+//spreads messages over shard threads by the instrument (or any key) TKey(const TMessage&) gives as uint64_t,
+//so that all of one instrument's messages are handled in order by one thread, which owns its state without
+//locks. a key goes to the shard it is assigned to, or else to one picked by its hash.
+//every producer has an SPSC inbox of N messages on every shard, so producers never contend with each other:
+//producer p, numbered from 0, posts from one thread only. each shard runs as a WorkerThread polling its
+//inboxes in turn and calls handler(shard, message) on its own thread.
+//assignments change only at a quiescent point: before Start(), or through Rebalance() while no producer posts
+template<class TMessage, class TKey, int N = 4096, int Routes = 1 << 16>
+class ShardedEngine
+{
+public:
+    typedef std::function<void ( int, TMessage& ) > Handler;
+    //called for every key a rebalance moves, while no shard handles messages, to carry the key's state across
+    typedef std::function<void ( uint64_t, int, int ) > Migration;
+
+    //one shard per WorkerOptions. throws std::invalid_argument without shards or producers
+    ShardedEngine ( const std::vector<WorkerOptions>& shards, int producers, Handler handler, TKey key = TKey() )
+        : producers ( producers ), handler ( std::move ( handler ) ), key ( key ), routes ( new RouteMap() ),
+          epoch ( 0 )
+    {
+        if ( shards.empty() || producers < 1 )
+        {
+            throw std::invalid_argument ( "ShardedEngine needs at least one shard and one producer" );
+        }
+        for ( std::size_t i = 0; i < shards.size(); i++ )
+        {
+            this->shards.emplace_back ( new Shard ( *this, static_cast<int> ( i ), shards[i] ) );
+        }
+    }
+
+    ~ShardedEngine()
+    {
+        Stop();
+    }
+
+    void Start()
+    {
+        for ( auto& shard : shards )
+        {
+            shard->Start();
+        }
+    }
+
+    //what was posted before is still handled
+    void Stop()
+    {
+        for ( auto& shard : shards )
+        {
+            shard->Stop();
+        }
+    }
+
+    inline int Shards() const
+    {
+        return static_cast<int> ( shards.size() );
+    }
+
+    inline int Producers() const
+    {
+        return producers;
+    }
+
+    //the shard handling key
+    inline int Route ( uint64_t key ) const
+    {
+        const int* assigned = routes->Find ( key );
+        if ( assigned != nullptr )
+        {
+            return *assigned;
+        }
+        return static_cast<int> ( ( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) % shards.size() );
+    }
+
+    //before Start() only, Rebalance() afterwards. false if shard is not one of Shards() or the assignment
+    //table is full
+    inline bool Assign ( uint64_t key, int shard )
+    {
+        return ValidShard ( shard ) && routes->Put ( key, shard );
+    }
+
+    //spin while the inbox is full
+    inline void Post ( int producer, const TMessage& message )
+    {
+        Inbox ( producer, message ).Enqueue ( message );
+    }
+
+    inline void Post ( int producer, TMessage&& message )
+    {
+        Inbox ( producer, message ).Enqueue ( std::move ( message ) );
+    }
+
+    //false if the inbox is full
+    inline bool TryPost ( int producer, const TMessage& message )
+    {
+        return Inbox ( producer, message ).TryEnqueue ( message );
+    }
+
+    inline bool TryPost ( int producer, TMessage&& message )
+    {
+        return Inbox ( producer, message ).TryEnqueue ( std::move ( message ) );
+    }
+
+    //move keys to other shards at a quiescent point: the caller makes sure no producer posts meanwhile.
+    //the shards first handle everything already posted, then park, so that migrate can move each key's
+    //state between them; they go on once every move is made. loop timers keep running while parked.
+    //false, with nothing moved, if a move names a shard out of range or the assignment table cannot take them
+    bool Rebalance ( const std::vector<std::pair<uint64_t, int>>& moves, const Migration& migrate = Migration() )
+    {
+        long added = 0;
+        for ( const auto& move : moves )
+        {
+            if ( !ValidShard ( move.second ) )
+            {
+                return false;
+            }
+            added += routes->Contains ( move.first ) ? 0 : 1;
+        }
+        if ( routes->Size() + added > routes->Capacity() )
+        {
+            return false;
+        }
+        Park();
+        for ( const auto& move : moves )
+        {
+            int from = Route ( move.first );
+            routes->Put ( move.first, move.second );
+            if ( from != move.second && migrate )
+            {
+                migrate ( move.first, from, move.second );
+            }
+        }
+        epoch.store ( epoch.load ( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        return true;
+    }
+
+    //throws std::out_of_range if shard is not one of Shards()
+    ShardStats Stats ( int shard ) const
+    {
+        return shards.at ( shard )->Stats();
+    }
+
+private:
+    ShardedEngine ( const ShardedEngine& );
+    ShardedEngine& operator= ( const ShardedEngine& ); // non-copyable
+
+    typedef container::SPSCRingBuffer<TMessage, N, BusySpinWait, container::FullPolicy::Spin> InboxRing;
+    typedef container::HashMap<uint64_t, int, Routes> RouteMap;
+
+    class Shard : public WorkerThread
+    {
+    public:
+        Shard ( ShardedEngine& engine, int index, WorkerOptions options )
+            : WorkerThread ( std::move ( options ) ), engine ( engine ), index ( index ), parked ( 0 ),
+              messages ( 0 ), batches ( 0 ), idle ( 0 )
+        {
+            for ( int i = 0; i < engine.producers; i++ )
+            {
+                inboxes.emplace_back ( new InboxRing() );
+            }
+        }
+
+        ~Shard()
+        {
+            Stop();
+        }
+
+        inline InboxRing& Inbox ( int producer )
+        {
+            return *inboxes[producer];
+        }
+
+        inline bool Parked ( long epoch ) const
+        {
+            return parked.load ( std::memory_order_acquire ) == epoch;
+        }
+
+        ShardStats Stats() const
+        {
+            ShardStats stats;
+            stats.messages = messages.load ( std::memory_order_relaxed );
+            stats.batches = batches.load ( std::memory_order_relaxed );
+            stats.idle = idle.load ( std::memory_order_relaxed );
+            for ( const auto& inbox : inboxes )
+            {
+                stats.pending += inbox->Size();
+                stats.rejected += inbox->Rejected();
+            }
+            return stats;
+        }
+
+    protected:
+        long Poll() override
+        {
+            //an odd epoch is a pause, the shard parks once it has found its inboxes empty in that epoch
+            long epoch = engine.epoch.load ( std::memory_order_acquire );
+            if ( ( epoch & 1 ) && parked.load ( std::memory_order_relaxed ) == epoch )
+            {
+                return 0;
+            }
+            long done = 0;
+            for ( auto& inbox : inboxes )
+            {
+                done += inbox->DequeueBatch ( [this] ( TMessage * batch, long count )
+                {
+                    for ( long i = 0; i < count; i++ )
+                    {
+                        engine.handler ( index, batch[i] );
+                    }
+                } );
+            }
+            Count ( done > 0 ? batches : idle, 1 );
+            Count ( messages, done );
+            //with the producers quiet, empty inboxes stay empty
+            if ( done == 0 && ( epoch & 1 ) )
+            {
+                parked.store ( epoch, std::memory_order_release );
+            }
+            return done;
+        }
+
+    private:
+        //single writer counters, read from any thread
+        static inline void Count ( std::atomic<uint64_t>& counter, long by )
+        {
+            counter.store ( counter.load ( std::memory_order_relaxed ) + by, std::memory_order_relaxed );
+        }
+
+        ShardedEngine& engine;
+        int index;
+        std::vector<std::unique_ptr<InboxRing>> inboxes;
+        std::atomic_long parked; // the pause epoch it parked in
+        std::atomic<uint64_t> messages;
+        std::atomic<uint64_t> batches;
+        std::atomic<uint64_t> idle;
+    };
+
+    inline bool ValidShard ( int shard ) const
+    {
+        return shard >= 0 && shard < Shards();
+    }
+
+    inline InboxRing& Inbox ( int producer, const TMessage& message )
+    {
+        return shards[Route ( key ( message ) )]->Inbox ( producer );
+    }
+
+    //have every running shard drain its inboxes and stop handling messages until the epoch moves on
+    void Park()
+    {
+        long pause = epoch.load ( std::memory_order_relaxed ) + 1;
+        epoch.store ( pause, std::memory_order_release );
+        for ( auto& shard : shards )
+        {
+            while ( shard->Running() && !shard->Parked ( pause ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    int producers;
+    Handler handler;
+    TKey key;
+    std::unique_ptr<RouteMap> routes;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic_long epoch;
+};
+}
+}
+
+#endif //LIBTRADE_ENGINE_H
@@ -0,0 +1,331 @@
+#ifndef LIBTRADE_HASHMAP_H
+#define LIBTRADE_HASHMAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#include "concurrent.h"
+#include "container.h"
+
+namespace trade
+{
+namespace container
+{
+namespace impl
+{
+//fixed capacity open addressing map with linear probing, the slots kept as separate arrays: 32 bit tags
+//(0 for an empty slot, else a fragment of the hash) that a probe scans 16 to a cache line, then keys and
+//values touched only on a tag match. erasing shifts the following entries back instead of leaving tombstones,
+//so probe lengths do not grow with churn. never allocates after construction.
+//with Concurrent, one writer and any number of readers: every slot has a seqlock the writer holds around its
+//stores, and a map wide one counts backward shifts, which move entries behind a reader's probe. readers copy
+//out through Get() and retry on a torn slot, or the whole probe if a shift ran while they found nothing
+template<class K, class V, int N, bool Concurrent, class THash, class TStorage>
+class OpenHashMap
+{
+public:
+    static_assert ( ( ( N > 1 ) && ( ( N & ( ~N + 1 ) ) == N ) ), "OpenHashMap's size must be a power of 2 above 1" );
+    static_assert ( !Concurrent || ( std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value ),
+                    "a concurrent map copies keys and values under seqlocks, they must be trivially copyable" );
+
+    explicit OpenHashMap ( const memory::Placement& placement = memory::Placement() )
+        : tags ( placement ), keys ( placement ), values ( placement ), seqs ( placement ), shifts ( 0 )
+    {
+    }
+
+    //false if key is there already, or the map is full (N - 1 entries, keep it under ~70% for short probes)
+    inline bool Insert ( const K& key, const V& value )
+    {
+        uint64_t hash = Hash ( key );
+        uint32_t tag = Tag ( hash );
+        for ( uint64_t i = Home ( hash ); ; i = ( i + 1 ) & mask )
+        {
+            if ( tags[i] == 0 )
+            {
+                if ( size == N - 1 )
+                {
+                    return false;
+                }
+                BeginWrite ( i );
+                keys[i] = key;
+                values[i] = value;
+                tags[i] = tag;
+                EndWrite ( i );
+                size++;
+                return true;
+            }
+            if ( tags[i] == tag && keys[i] == key )
+            {
+                return false;
+            }
+        }
+    }
+
+    //insert or overwrite, false if the map is full
+    inline bool Put ( const K& key, const V& value )
+    {
+        return Update ( key, value ) || Insert ( key, value );
+    }
+
+    //overwrite the value of key, false if it is not there
+    inline bool Update ( const K& key, const V& value )
+    {
+        return Modify ( key, [&value] ( V & current )
+        {
+            current = value;
+        } );
+    }
+
+    //action(V&) on the value of key under its slot's seqlock, false if it is not there
+    template<class TFunc>
+    inline bool Modify ( const K& key, const TFunc& action )
+    {
+        long i = Locate ( key );
+        if ( i < 0 )
+        {
+            return false;
+        }
+        BeginWrite ( i );
+        action ( values[i] );
+        EndWrite ( i );
+        return true;
+    }
+
+    //writer side (any side without Concurrent). in a concurrent map writing through the pointer bypasses the
+    //seqlocks, use Modify there
+    inline V* Find ( const K& key )
+    {
+        long i = Locate ( key );
+        return i < 0 ? nullptr : &values[i];
+    }
+
+    inline const V* Find ( const K& key ) const
+    {
+        long i = Locate ( key );
+        return i < 0 ? nullptr : &values[i];
+    }
+
+    //copy the value of key into out, from any thread
+    inline bool Get ( const K& key, V& out ) const
+    {
+        if ( !Concurrent )
+        {
+            const V* value = Find ( key );
+            if ( value != nullptr )
+            {
+                out = *value;
+            }
+            return value != nullptr;
+        }
+        uint64_t hash = Hash ( key );
+        uint32_t tag = Tag ( hash );
+        while ( true )
+        {
+            uint32_t moved = shifts.load ( std::memory_order_acquire );
+            if ( moved & 1 )
+            {
+                concurrent::CpuRelax();
+                continue;
+            }
+            for ( uint64_t i = Home ( hash ); ; )
+            {
+                uint32_t seq = seqs[i].load ( std::memory_order_acquire );
+                if ( seq & 1 )
+                {
+                    concurrent::CpuRelax();
+                    continue;
+                }
+                uint32_t seen = tags[i];
+                bool match = seen == tag && keys[i] == key;
+                V value;
+                if ( match )
+                {
+                    value = values[i];
+                }
+                std::atomic_thread_fence ( std::memory_order_acquire );
+                if ( seqs[i].load ( std::memory_order_relaxed ) != seq )
+                {
+                    continue; // torn, read the slot again
+                }
+                if ( match )
+                {
+                    out = value;
+                    return true;
+                }
+                if ( seen == 0 )
+                {
+                    break;
+                }
+                i = ( i + 1 ) & mask;
+            }
+            //not found: only true if no entry moved back past the probe meanwhile
+            if ( shifts.load ( std::memory_order_relaxed ) == moved )
+            {
+                return false;
+            }
+        }
+    }
+
+    inline bool Contains ( const K& key ) const
+    {
+        return Locate ( key ) >= 0;
+    }
+
+    //false if key is not there
+    inline bool Erase ( const K& key )
+    {
+        long found = Locate ( key );
+        if ( found < 0 )
+        {
+            return false;
+        }
+        uint64_t hole = static_cast<uint64_t> ( found );
+        bool shifting = false;
+        //pull back every following entry whose probe passes through the hole
+        for ( uint64_t j = ( hole + 1 ) & mask; tags[j] != 0; j = ( j + 1 ) & mask )
+        {
+            uint64_t home = Home ( Hash ( keys[j] ) );
+            if ( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) )
+            {
+                if ( Concurrent && !shifting )
+                {
+                    shifting = true;
+                    shifts.store ( shifts.load ( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                    std::atomic_thread_fence ( std::memory_order_release );
+                }
+                BeginWrite ( hole );
+                keys[hole] = keys[j];
+                values[hole] = values[j];
+                tags[hole] = tags[j];
+                EndWrite ( hole );
+                hole = j;
+            }
+        }
+        BeginWrite ( hole );
+        tags[hole] = 0;
+        EndWrite ( hole );
+        if ( shifting )
+        {
+            shifts.store ( shifts.load ( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+        size--;
+        return true;
+    }
+
+    //action(const K&, V&) on every entry, in slot order. writer side
+    template<class TFunc>
+    inline void ForEach ( const TFunc& action )
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            if ( tags[i] != 0 )
+            {
+                action ( static_cast<const K&> ( keys[i] ), values[i] );
+            }
+        }
+    }
+
+    inline void Clear()
+    {
+        for ( long i = 0; i < N; i++ )
+        {
+            if ( tags[i] != 0 )
+            {
+                BeginWrite ( i );
+                tags[i] = 0;
+                EndWrite ( i );
+            }
+        }
+        size = 0;
+    }
+
+    inline long Size() const
+    {
+        return size;
+    }
+
+    static constexpr long Capacity()
+    {
+        return N - 1;
+    }
+
+private:
+    OpenHashMap ( const OpenHashMap& );
+    OpenHashMap& operator= ( const OpenHashMap& ); // non-copyable
+
+    //fibonacci hashing over THash, whose integers hash to themselves: the home slot from the top bits, the tag
+    //from bits below them, never 0
+    inline uint64_t Hash ( const K& key ) const
+    {
+        return static_cast<uint64_t> ( hasher ( key ) ) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static inline uint64_t Home ( uint64_t hash )
+    {
+        return hash >> ( 64 - impl::Log2 ( N ) );
+    }
+
+    static inline uint32_t Tag ( uint64_t hash )
+    {
+        return static_cast<uint32_t> ( hash >> 16 ) | 1;
+    }
+
+    inline long Locate ( const K& key ) const
+    {
+        uint64_t hash = Hash ( key );
+        uint32_t tag = Tag ( hash );
+        for ( uint64_t i = Home ( hash ); ; i = ( i + 1 ) & mask )
+        {
+            if ( tags[i] == 0 )
+            {
+                return -1;
+            }
+            if ( tags[i] == tag && keys[i] == key )
+            {
+                return static_cast<long> ( i );
+            }
+        }
+    }
+
+    inline void BeginWrite ( uint64_t i )
+    {
+        if ( Concurrent )
+        {
+            seqs[i].store ( seqs[i].load ( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            std::atomic_thread_fence ( std::memory_order_release );
+        }
+    }
+
+    inline void EndWrite ( uint64_t i )
+    {
+        if ( Concurrent )
+        {
+            seqs[i].store ( seqs[i].load ( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+    }
+
+    static constexpr uint64_t mask = N - 1;
+
+    impl::ValueArray<uint32_t, N, TStorage> tags;
+    impl::ValueArray<K, N, TStorage> keys;
+    impl::ValueArray<V, N, TStorage> values;
+    impl::ValueArray<std::atomic<uint32_t>, Concurrent ? N : 1, TStorage> seqs;
+    std::atomic<uint32_t> shifts;
+    long size = 0;
+    THash hasher;
+};
+}
+
+//single threaded, or guarded by the caller
+template<class K, class V, int N, class THash = std::hash<K>, class TStorage = InlineStorage>
+using HashMap = impl::OpenHashMap<K, V, N, false, THash, TStorage>;
+
+//one writer thread, readers on any thread through Get()
+template<class K, class V, int N, class THash = std::hash<K>, class TStorage = InlineStorage>
+using ConcurrentHashMap = impl::OpenHashMap<K, V, N, true, THash, TStorage>;
+}
+}
+
+#endif //LIBTRADE_HASHMAP_H
@@ -0,0 +1,419 @@
+#include "journal.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace trade
+{
+namespace journal
+{
+namespace
+{
+struct SegmentHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t index;
+    uint64_t size;
+};
+
+constexpr char Magic[8] = { 'L', 'T', 'J', 'O', 'U', 'R', 'N', 'L' };
+constexpr uint32_t Version = 1;
+
+std::runtime_error Failure ( const std::string& what, const std::string& path )
+{
+    return std::runtime_error ( "journal: " + what + " " + path );
+}
+
+//close the data of a segment at position with a padding record, or leave the zeroes if there is no room
+//for one: readers move on to the next segment either way
+void Seal ( char* data, std::size_t size, std::size_t position )
+{
+    if ( position + sizeof ( RecordHeader ) > size )
+    {
+        return;
+    }
+    RecordHeader* padding = reinterpret_cast<RecordHeader*> ( data + position );
+    padding->length = static_cast<uint32_t> ( size - position - sizeof ( RecordHeader ) );
+    padding->type = PaddingType;
+    padding->timestamp = 0;
+    __atomic_store_n ( &padding->committed, static_cast<uint16_t> ( 1 ), __ATOMIC_RELEASE );
+}
+
+//first position after the committed records of a segment
+std::size_t End ( const char* data, std::size_t size )
+{
+    std::size_t position = SegmentHeaderSize;
+    while ( position + sizeof ( RecordHeader ) <= size )
+    {
+        const RecordHeader* header = reinterpret_cast<const RecordHeader*> ( data + position );
+        if ( __atomic_load_n ( &header->committed, __ATOMIC_ACQUIRE ) == 0 )
+        {
+            break;
+        }
+        position += RecordSize ( header->length );
+    }
+    return position;
+}
+}
+
+namespace impl
+{
+std::string Segment::Path ( const std::string& directory, const std::string& name, uint64_t index )
+{
+    char number[32];
+    std::snprintf ( number, sizeof ( number ), ".%06llu.journal", static_cast<unsigned long long> ( index ) );
+    return directory + "/" + name + number;
+}
+
+Segment::Segment ( const std::string& path, uint64_t index, std::size_t size, Open mode ) : index ( index )
+{
+    bool create = mode == Open::Create;
+    fd = create ? open ( path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) :
+         open ( path.c_str(), mode == Open::Write ? O_RDWR : O_RDONLY );
+    if ( fd < 0 )
+    {
+        throw Failure ( "cannot open", path );
+    }
+    if ( create )
+    {
+        if ( ftruncate ( fd, static_cast<off_t> ( size ) ) != 0 )
+        {
+            close ( fd );
+            throw Failure ( "cannot size", path );
+        }
+#if defined(__linux__)
+        posix_fallocate ( fd, 0, static_cast<off_t> ( size ) );
+#endif
+    }
+    else
+    {
+        struct stat info;
+        if ( fstat ( fd, &info ) != 0 || static_cast<std::size_t> ( info.st_size ) < SegmentHeaderSize )
+        {
+            close ( fd );
+            throw Failure ( "not a segment", path );
+        }
+        size = static_cast<std::size_t> ( info.st_size );
+    }
+    void* mapped = mmap ( nullptr, size, mode == Open::Read ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( mapped == MAP_FAILED )
+    {
+        close ( fd );
+        throw Failure ( "cannot map", path );
+    }
+    if ( mode == Open::Read )
+    {
+        //read front to back: read ahead further and drop pages behind
+        madvise ( mapped, size, MADV_SEQUENTIAL );
+    }
+    data = static_cast<char*> ( mapped );
+    this->size = size;
+    SegmentHeader* header = reinterpret_cast<SegmentHeader*> ( data );
+    if ( create )
+    {
+        //written through once so that the writer never takes a page fault in it
+        memory::Prefault ( data, size );
+        std::memcpy ( header->magic, Magic, sizeof ( Magic ) );
+        header->version = Version;
+        header->header_size = SegmentHeaderSize;
+        header->index = index;
+        header->size = size;
+    }
+    else if ( std::memcmp ( header->magic, Magic, sizeof ( Magic ) ) != 0 || header->size != size )
+    {
+        munmap ( data, size );
+        close ( fd );
+        throw Failure ( "not a segment", path );
+    }
+}
+
+Segment::~Segment()
+{
+    munmap ( data, size );
+    close ( fd );
+}
+
+void Segment::Sync ( std::size_t from, std::size_t to )
+{
+    from -= from % memory::PageSize;
+    if ( to > from )
+    {
+        msync ( data + from, std::min ( to, size ) - from, MS_SYNC );
+    }
+}
+
+std::vector<uint64_t> SegmentIndices ( const std::string& directory, const std::string& name )
+{
+    std::vector<uint64_t> indices;
+    DIR* dir = opendir ( directory.c_str() );
+    if ( dir == nullptr )
+    {
+        return indices;
+    }
+    std::string prefix = name + ".";
+    std::string suffix = ".journal";
+    while ( dirent* entry = readdir ( dir ) )
+    {
+        std::string file = entry->d_name;
+        if ( file.size() > prefix.size() + suffix.size() && file.compare ( 0, prefix.size(), prefix ) == 0 &&
+                file.compare ( file.size() - suffix.size(), suffix.size(), suffix ) == 0 )
+        {
+            std::string number = file.substr ( prefix.size(), file.size() - prefix.size() - suffix.size() );
+            if ( !number.empty() && number.find_first_not_of ( "0123456789" ) == std::string::npos )
+            {
+                indices.push_back ( std::stoull ( number ) );
+            }
+        }
+    }
+    closedir ( dir );
+    std::sort ( indices.begin(), indices.end() );
+    return indices;
+}
+}
+
+Writer::Writer ( std::string directory, std::string name, std::size_t segment_size, int flush_interval )
+    : directory ( std::move ( directory ) ), name ( std::move ( name ) ),
+      segment_size ( ( segment_size + memory::PageSize - 1 ) / memory::PageSize * memory::PageSize ),
+      flush_interval ( flush_interval ), committed ( SegmentHeaderSize )
+{
+    uint64_t index = 0;
+    std::vector<uint64_t> existing = impl::SegmentIndices ( this->directory, this->name );
+    if ( !existing.empty() )
+    {
+        //close the last segment of an earlier writer, which may have died without, and start after it
+        impl::Segment last ( impl::Segment::Path ( this->directory, this->name, existing.back() ), existing.back(), 0,
+                             impl::Segment::Open::Write );
+        Seal ( last.Data(), last.Size(), End ( last.Data(), last.Size() ) );
+        index = existing.back() + 1;
+    }
+    current = Create ( index );
+    active = current.get();
+    flusher = std::thread ( [this]
+    {
+        Flusher();
+    } );
+}
+
+Writer::~Writer()
+{
+    {
+        std::lock_guard<std::mutex> lock ( protect );
+        stop = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    if ( next )
+    {
+        //prepared but never used, gone before the seal below sends readers looking for it
+        std::string path = impl::Segment::Path ( directory, name, next->Index() );
+        next.reset();
+        unlink ( path.c_str() );
+    }
+    Seal ( active->Data(), active->Size(), position );
+    for ( auto& segment : retired )
+    {
+        segment->Sync ( SegmentHeaderSize, segment->Size() );
+    }
+    current->Sync ( SegmentHeaderSize, active->Size() );
+}
+
+std::unique_ptr<impl::Segment> Writer::Create ( uint64_t index )
+{
+    return std::unique_ptr<impl::Segment> ( new impl::Segment ( impl::Segment::Path ( directory, name, index ), index,
+                                            segment_size, impl::Segment::Open::Create ) );
+}
+
+void Writer::Roll ( std::size_t need )
+{
+    if ( need > segment_size - SegmentHeaderSize )
+    {
+        throw std::invalid_argument ( "journal: record larger than a segment" );
+    }
+    Seal ( active->Data(), active->Size(), position );
+    {
+        std::unique_lock<std::mutex> lock ( protect );
+        while ( preparing )
+        {
+            wake.wait ( lock );
+        }
+        uint64_t index = current->Index() + 1;
+        retired.push_back ( std::move ( current ) );
+        if ( next && next->Index() == index )
+        {
+            current = std::move ( next );
+        }
+        else
+        {
+            next.reset();
+            current = Create ( index );
+        }
+        active = current.get();
+        position = SegmentHeaderSize;
+        flushed = SegmentHeaderSize;
+        committed.store ( position, std::memory_order_release );
+    }
+    wake.notify_one();
+}
+
+void Writer::Flush()
+{
+    //msync without holding protect, so that neither Roll nor the flusher waits behind it. retired segments are
+    //borrowed and given back for the flusher to unmap, current only changes on this thread
+    std::vector<std::unique_ptr<impl::Segment>> borrowed;
+    std::size_t from = SegmentHeaderSize;
+    {
+        std::lock_guard<std::mutex> lock ( protect );
+        borrowed.swap ( retired );
+        from = flushed;
+    }
+    for ( auto& segment : borrowed )
+    {
+        segment->Sync ( SegmentHeaderSize, segment->Size() );
+    }
+    std::size_t to = committed.load ( std::memory_order_acquire );
+    current->Sync ( from, to );
+
+    std::unique_lock<std::mutex> lock ( protect );
+    retired.insert ( retired.begin(), std::make_move_iterator ( borrowed.begin() ),
+                     std::make_move_iterator ( borrowed.end() ) );
+    flushed = std::max ( flushed, to );
+    //segments the flusher took over before are still being written back
+    while ( writing_back )
+    {
+        wake.wait ( lock );
+    }
+}
+
+void Writer::Flusher()
+{
+    std::unique_lock<std::mutex> lock ( protect );
+    while ( !stop )
+    {
+        //the next segment as soon as the writer has taken the last one, so that Roll finds it ready. preparing
+        //only covers the creation, Roll never waits behind a write back
+        uint64_t index = current->Index();
+        if ( !next )
+        {
+            preparing = true;
+            lock.unlock();
+            std::unique_ptr<impl::Segment> prepared;
+            try
+            {
+                prepared = Create ( index + 1 );
+            }
+            catch ( const std::runtime_error& )
+            {
+                //the writer will try again itself when it gets there
+            }
+            lock.lock();
+            next = std::move ( prepared );
+            preparing = false;
+            wake.notify_all();
+        }
+
+        //finished segments: write back and unmap. then what was committed to the current one since last time
+        std::vector<std::unique_ptr<impl::Segment>> done;
+        done.swap ( retired );
+        impl::Segment* segment = current.get();
+        std::size_t from = flushed;
+        std::size_t to = committed.load ( std::memory_order_acquire );
+        writing_back = true;
+        lock.unlock();
+
+        for ( auto& finished : done )
+        {
+            finished->Sync ( SegmentHeaderSize, finished->Size() );
+        }
+        done.clear();
+        segment->Sync ( from, to );
+
+        lock.lock();
+        if ( current.get() == segment )
+        {
+            flushed = std::max ( flushed, to );
+        }
+        writing_back = false;
+        wake.notify_all();
+        //every flush_interval, or as soon as Roll has taken next
+        wake.wait_for ( lock, std::chrono::milliseconds ( flush_interval ), [this, index]
+        {
+            return stop || current->Index() != index;
+        } );
+    }
+}
+
+Reader::Reader ( std::string directory, std::string name ) : directory ( std::move ( directory ) ), name ( std::move ( name ) )
+{
+    std::vector<uint64_t> indices = impl::SegmentIndices ( this->directory, this->name );
+    if ( indices.empty() )
+    {
+        throw Failure ( "no segments of", this->directory + "/" + this->name );
+    }
+    segment.reset ( new impl::Segment ( impl::Segment::Path ( this->directory, this->name, indices.front() ),
+                                        indices.front(), 0, impl::Segment::Open::Read ) );
+}
+
+Reader::~Reader()
+{
+}
+
+bool Reader::Next ( Record& record )
+{
+    while ( true )
+    {
+        if ( position + sizeof ( RecordHeader ) > segment->Size() )
+        {
+            if ( !Advance() )
+            {
+                return false;
+            }
+            continue;
+        }
+        const RecordHeader* header = reinterpret_cast<const RecordHeader*> ( segment->Data() + position );
+        if ( __atomic_load_n ( &header->committed, __ATOMIC_ACQUIRE ) == 0 )
+        {
+            return false;
+        }
+        if ( header->type == PaddingType )
+        {
+            if ( !Advance() )
+            {
+                return false;
+            }
+            continue;
+        }
+        position += RecordSize ( header->length );
+        record.header = header;
+        return true;
+    }
+}
+
+//open the segment after this one, false (staying put) if it is not there yet
+bool Reader::Advance()
+{
+    uint64_t index = segment->Index() + 1;
+    std::string path = impl::Segment::Path ( directory, name, index );
+    try
+    {
+        segment.reset ( new impl::Segment ( path, index, 0, impl::Segment::Open::Read ) );
+    }
+    catch ( const std::runtime_error& )
+    {
+        return false;
+    }
+    position = SegmentHeaderSize;
+    return true;
+}
+}
+}
@@ -0,0 +1,352 @@
+#ifndef LIBTRADE_JOURNAL_H
+#define LIBTRADE_JOURNAL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "clock.h"
+
+namespace trade
+{
+namespace journal
+{
+//a journal is a series of segment files <directory>/<name>.<index>.journal of one fixed size, created ahead of
+//need, mapped and written in place. a segment is a 64 byte header then records, each a RecordHeader and its
+//payload padded to 8 bytes. a record is published by the release store of its committed flag, so a reader may
+//follow a journal while it is written. a record that does not fit leaves a padding record, or less than a
+//header of zeroes, and goes to the next segment
+struct RecordHeader
+{
+    uint32_t length; // payload bytes
+    uint16_t type; // the application's record type, PaddingType is reserved
+    uint16_t committed;
+    int64_t timestamp;
+};
+
+static_assert ( sizeof ( RecordHeader ) == 16, "RecordHeader is part of the file format" );
+
+static constexpr uint16_t PaddingType = 0xffff;
+static constexpr std::size_t SegmentHeaderSize = 64;
+static constexpr std::size_t DefaultSegmentSize = std::size_t ( 256 ) << 20;
+
+inline std::size_t RecordSize ( uint32_t length )
+{
+    return ( sizeof ( RecordHeader ) + length + 7 ) & ~std::size_t ( 7 );
+}
+
+namespace impl
+{
+//one mapped segment file
+class Segment
+{
+public:
+    static std::string Path ( const std::string& directory, const std::string& name, uint64_t index );
+
+    enum class Open
+    {
+        Create, // size, map and fault in a new file of size bytes
+        Write,
+        Read
+    };
+
+    //size is only used to create, an existing segment is as large as its file. throws std::runtime_error
+    Segment ( const std::string& path, uint64_t index, std::size_t size, Open mode );
+    ~Segment();
+
+    inline char* Data() const
+    {
+        return data;
+    }
+
+    inline std::size_t Size() const
+    {
+        return size;
+    }
+
+    inline uint64_t Index() const
+    {
+        return index;
+    }
+
+    //write back [from, to) and wait for it
+    void Sync ( std::size_t from, std::size_t to );
+
+private:
+    Segment ( const Segment& );
+    Segment& operator= ( const Segment& ); // non-copyable
+
+    char* data = nullptr;
+    std::size_t size = 0;
+    uint64_t index;
+    int fd = -1;
+};
+
+//indices of the segments of name in directory, ascending
+std::vector<uint64_t> SegmentIndices ( const std::string& directory, const std::string& name );
+}
+
+//appends records from one thread. a background thread creates and faults in the next segment before it is
+//needed, writes committed data back every flush_interval milliseconds and unmaps finished segments, so the
+//writer only ever stores into memory that is already mapped. a new Writer starts a segment after the last
+//one found, never overwriting. throws std::runtime_error when a segment cannot be created
+class Writer
+{
+public:
+    Writer ( std::string directory, std::string name, std::size_t segment_size = DefaultSegmentSize,
+             int flush_interval = 100 );
+    ~Writer();
+
+    //room for length bytes of payload, written in place before Commit(). throws std::invalid_argument if
+    //the record cannot fit a segment
+    inline void* Claim ( uint16_t type, int64_t timestamp, uint32_t length )
+    {
+        std::size_t need = RecordSize ( length );
+        if ( position + need > active->Size() )
+        {
+            Roll ( need );
+        }
+        claimed = reinterpret_cast<RecordHeader*> ( active->Data() + position );
+        claimed->length = length;
+        claimed->type = type;
+        claimed->timestamp = timestamp;
+        return claimed + 1;
+    }
+
+    inline void Commit()
+    {
+        __atomic_store_n ( &claimed->committed, static_cast<uint16_t> ( 1 ), __ATOMIC_RELEASE );
+        position += RecordSize ( claimed->length );
+        committed.store ( position, std::memory_order_release );
+        records++;
+    }
+
+    inline void Append ( uint16_t type, int64_t timestamp, const void* data, uint32_t length )
+    {
+        std::memcpy ( Claim ( type, timestamp, length ), data, length );
+        Commit();
+    }
+
+    //a fixed size record
+    template<class T>
+    inline void Append ( uint16_t type, int64_t timestamp, const T& record )
+    {
+        static_assert ( std::is_trivially_copyable<T>::value, "journal records are copied bytewise" );
+        Append ( type, timestamp, &record, sizeof ( T ) );
+    }
+
+    //write back everything committed so far and wait for it
+    void Flush();
+
+    inline uint64_t Records() const
+    {
+        return records;
+    }
+
+    inline uint64_t SegmentIndex() const
+    {
+        return active->Index();
+    }
+
+private:
+    Writer ( const Writer& );
+    Writer& operator= ( const Writer& ); // non-copyable
+
+    void Roll ( std::size_t need );
+    void Flusher();
+    std::unique_ptr<impl::Segment> Create ( uint64_t index );
+
+    std::string directory;
+    std::string name;
+    std::size_t segment_size;
+    int flush_interval;
+
+    //writer thread
+    impl::Segment* active = nullptr;
+    std::size_t position = SegmentHeaderSize;
+    RecordHeader* claimed = nullptr;
+    uint64_t records = 0;
+
+    //shared with the flusher, segments change hands under protect
+    std::atomic<std::size_t> committed;
+    std::mutex protect;
+    std::condition_variable wake;
+    std::unique_ptr<impl::Segment> current;
+    std::unique_ptr<impl::Segment> next;
+    std::vector<std::unique_ptr<impl::Segment>> retired;
+    std::size_t flushed = SegmentHeaderSize;
+    bool preparing = false; // the flusher is creating next, the writer must not create it too
+    bool writing_back = false; // the flusher is syncing segments without holding protect, Flush waits for it
+    bool stop = false;
+    std::thread flusher;
+};
+
+//a record as it lies in a mapped segment, valid until the reader moves past that segment
+class Record
+{
+public:
+    inline uint16_t Type() const
+    {
+        return header->type;
+    }
+
+    inline int64_t Timestamp() const
+    {
+        return header->timestamp;
+    }
+
+    inline uint32_t Length() const
+    {
+        return header->length;
+    }
+
+    inline const void* Data() const
+    {
+        return header + 1;
+    }
+
+    template<class T>
+    inline const T& As() const
+    {
+        return *static_cast<const T*> ( Data() );
+    }
+
+private:
+    friend class Reader;
+    const RecordHeader* header = nullptr;
+};
+
+//walks a journal from its first segment without copying, and can follow it while it is written: Next()
+//returning false only means nothing more is committed yet. keeps one segment mapped at a time
+class Reader
+{
+public:
+    //throws std::runtime_error if there is no such journal
+    Reader ( std::string directory, std::string name );
+    ~Reader();
+
+    bool Next ( Record& record );
+
+    //action(const Record&) on every committed record from here on, returns how many
+    template<class TFunc>
+    inline long Scan ( const TFunc& action )
+    {
+        Record record;
+        long count = 0;
+        while ( Next ( record ) )
+        {
+            action ( static_cast<const Record&> ( record ) );
+            count++;
+        }
+        return count;
+    }
+
+    inline uint64_t SegmentIndex() const
+    {
+        return segment->Index();
+    }
+
+private:
+    Reader ( const Reader& );
+    Reader& operator= ( const Reader& ); // non-copyable
+
+    bool Advance();
+
+    std::string directory;
+    std::string name;
+    std::unique_ptr<impl::Segment> segment;
+    std::size_t position = SegmentHeaderSize;
+};
+
+//the record time of a Tee: the clock at the moment the tee copies the element
+struct ClockStamp
+{
+    template<class T>
+    inline int64_t operator() ( const T& ) const
+    {
+        return concurrent::TscClock::Now();
+    }
+};
+
+//copies what a ring publishes into a journal, reading with a cursor of its own next to the ring's consumers
+//(any ring whose GetLatestEntryIndex() is the last published element, e.g. SPSCRingBuffer or SyncRingBuffer).
+//run Poll() from a thread other than the hot path, e.g. as a runtime worker's poll: the producer never waits
+//for it, but a tee falling a whole ring behind loses what was overwritten. TStamp(const T&) gives the record
+//time, e.g. the exchange time inside the element
+template<class TRing, class TStamp = ClockStamp>
+class Tee
+{
+public:
+    Tee ( TRing& ring, Writer& writer, uint16_t type, long cursor = 0, TStamp stamp = TStamp() )
+        : ring ( ring ), writer ( writer ), type ( type ), cursor ( cursor ), stamp ( stamp )
+    {
+    }
+
+    //journal everything published since the last call, returns how many. every element is copied out of
+    //the ring and checked against its head before it is journalled, seqlock style: one the producer may have
+    //been rewriting meanwhile is counted in Skipped() instead
+    inline long Poll()
+    {
+        long count = 0;
+        long capacity = ring.Capacity();
+        long head = Head();
+        if ( head - cursor >= capacity )
+        {
+            skipped += head - capacity + 1 - cursor;
+            cursor = head - capacity + 1;
+        }
+        for ( ; cursor < head; cursor++ )
+        {
+            Element element = ring[cursor];
+            std::atomic_thread_fence ( std::memory_order_acquire );
+            if ( Head() - cursor >= capacity )
+            {
+                skipped++;
+                continue;
+            }
+            writer.Append ( type, stamp ( element ), element );
+            count++;
+        }
+        return count;
+    }
+
+    inline long Cursor() const
+    {
+        return cursor;
+    }
+
+    //elements overwritten before the tee got to them
+    inline long Skipped() const
+    {
+        return skipped;
+    }
+
+private:
+    typedef typename std::decay<decltype ( std::declval<TRing&>() [0] ) >::type Element;
+
+    inline long Head() const
+    {
+        long head = ring.GetLatestEntryIndex() + 1;
+        std::atomic_thread_fence ( std::memory_order_acquire );
+        return head;
+    }
+
+    TRing& ring;
+    Writer& writer;
+    uint16_t type;
+    long cursor;
+    long skipped = 0;
+    TStamp stamp;
+};
+}
+}
+
+#endif //LIBTRADE_JOURNAL_H
@@ -0,0 +1,176 @@
+#include "memory.h"
+
+#include <new>
+#include <utility>
+
+#if defined(_WIN32) || defined(_WIN64)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace trade
+{
+namespace memory
+{
+namespace
+{
+inline std::size_t RoundUp ( std::size_t size, std::size_t page )
+{
+    return ( size + page - 1 ) / page * page;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+//explicit huge page mapping of the given size, nullptr if there are none to be had
+void* MapHuge ( std::size_t size, Pages pages )
+{
+#if defined(MAP_HUGETLB)
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#if defined(MAP_HUGE_SHIFT)
+    flags |= ( pages == Pages::Huge1G ? 30 : 21 ) << MAP_HUGE_SHIFT;
+#endif
+    void* mapped = mmap ( nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0 );
+    return mapped == MAP_FAILED ? nullptr : mapped;
+#else
+    ( void ) size;
+    ( void ) pages;
+    return nullptr;
+#endif
+}
+#endif
+}
+
+void Prefault ( void* data, std::size_t size )
+{
+    volatile char* bytes = static_cast<volatile char*> ( data );
+    for ( std::size_t offset = 0; offset < size; offset += PageSize )
+    {
+        bytes[offset] = bytes[offset];
+    }
+}
+
+bool BindToNode ( void* data, std::size_t size, int node )
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    static constexpr int MPOL_BIND = 2;
+    static constexpr int MaxNodes = 1024;
+    if ( node < 0 || node >= MaxNodes )
+    {
+        return false;
+    }
+    unsigned long mask[MaxNodes / ( 8 * sizeof ( unsigned long ) )] = {};
+    mask[node / ( 8 * sizeof ( unsigned long ) )] = 1ul << ( node % ( 8 * sizeof ( unsigned long ) ) );
+    return syscall ( SYS_mbind, data, size, MPOL_BIND, mask, MaxNodes + 1, 0 ) == 0;
+#else
+    ( void ) data;
+    ( void ) size;
+    ( void ) node;
+    return false;
+#endif
+}
+
+Region::Region ( std::size_t size, bool huge_pages, bool prefault )
+    : Region ( size, Placement ( huge_pages ? Pages::Huge2M : Pages::Normal, -1, prefault ) )
+{
+}
+
+Region::Region ( std::size_t size, const Placement& placement )
+{
+#if defined(_WIN32) || defined(_WIN64)
+    this->size = RoundUp ( size, PageSize );
+    data = VirtualAlloc ( nullptr, this->size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+    if ( data == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+#else
+    if ( placement.pages == Pages::Huge1G )
+    {
+        this->size = RoundUp ( size, GiantPageSize );
+        data = MapHuge ( this->size, Pages::Huge1G );
+        backing = Pages::Huge1G;
+    }
+    if ( data == nullptr && placement.pages != Pages::Normal )
+    {
+        this->size = RoundUp ( size, HugePageSize );
+        data = MapHuge ( this->size, Pages::Huge2M );
+        backing = Pages::Huge2M;
+    }
+    if ( data == nullptr )
+    {
+        backing = Pages::Normal;
+        this->size = placement.pages == Pages::Normal ? RoundUp ( size, PageSize ) : RoundUp ( size, HugePageSize );
+        void* mapped = mmap ( nullptr, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( mapped == MAP_FAILED )
+        {
+            throw std::bad_alloc();
+        }
+        data = mapped;
+#if defined(MADV_HUGEPAGE)
+        if ( placement.pages != Pages::Normal )
+        {
+            madvise ( data, this->size, MADV_HUGEPAGE );
+        }
+#endif
+    }
+#endif
+    //first touch decides where a page lands, so bind before faulting anything in
+    if ( placement.node >= 0 )
+    {
+        bound = BindToNode ( data, this->size, placement.node );
+    }
+    if ( placement.prefault )
+    {
+        Prefault ( data, this->size );
+    }
+}
+
+Region::~Region()
+{
+    Release();
+}
+
+Region::Region ( Region&& other ) noexcept
+    : data ( other.data ), size ( other.size ), backing ( other.backing ), bound ( other.bound )
+{
+    other.data = nullptr;
+    other.size = 0;
+}
+
+Region& Region::operator= ( Region&& other ) noexcept
+{
+    if ( this != &other )
+    {
+        Release();
+        std::swap ( data, other.data );
+        std::swap ( size, other.size );
+        std::swap ( backing, other.backing );
+        std::swap ( bound, other.bound );
+    }
+    return *this;
+}
+
+void Region::Release()
+{
+    if ( data == nullptr )
+    {
+        return;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    VirtualFree ( data, 0, MEM_RELEASE );
+#else
+    munmap ( data, size );
+#endif
+    data = nullptr;
+    size = 0;
+}
+}
+}
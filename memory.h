@@ -0,0 +1,99 @@
+#ifndef LIBTRADE_MEMORY_H
+#define LIBTRADE_MEMORY_H
+
+#include <cstddef>
+
+namespace trade
+{
+namespace memory
+{
+static constexpr std::size_t PageSize = 4096;
+static constexpr std::size_t HugePageSize = 2 << 20;
+static constexpr std::size_t GiantPageSize = 1 << 30;
+
+enum class Pages
+{
+    Normal,
+    Huge2M,
+    Huge1G
+};
+
+//how a Region is backed: page size (explicit huge pages first, falling back to the next smaller size and
+//finally to normal pages advised for transparent huge pages), NUMA node to bind to (-1 leaves it to the
+//first touch) and whether to fault every page in at construction
+struct Placement
+{
+    Pages pages = Pages::Normal;
+    int node = -1;
+    bool prefault = true;
+
+    Placement() = default;
+
+    Placement ( Pages pages, int node = -1, bool prefault = true ) : pages ( pages ), node ( node ), prefault ( prefault )
+    {
+    }
+};
+
+//touch every page of [data, data + size) so that the page faults are taken now instead of on the hot path
+void Prefault ( void* data, std::size_t size );
+
+//bind [data, data + size) to a NUMA node with mbind(2), before it is touched. false when the kernel refuses,
+//e.g. without NUMA support or for a node that does not exist
+bool BindToNode ( void* data, std::size_t size, int node );
+
+//anonymous private memory straight from the kernel, zero filled, placed as asked by Placement.
+//explicit huge pages need vm.nr_hugepages (or hugepagesz=1G for 1G pages) to be reserved.
+//throws std::bad_alloc when the mapping fails
+class Region
+{
+public:
+    Region() = default;
+    Region ( std::size_t size, const Placement& placement );
+    Region ( std::size_t size, bool huge_pages = false, bool prefault = false );
+    ~Region();
+
+    Region ( Region&& other ) noexcept;
+    Region& operator= ( Region&& other ) noexcept;
+
+    inline void* Data() const
+    {
+        return data;
+    }
+
+    inline std::size_t Size() const
+    {
+        return size;
+    }
+
+    //the page size the region actually got
+    inline Pages Backing() const
+    {
+        return backing;
+    }
+
+    //true if the region is backed by explicit huge pages
+    inline bool HugePages() const
+    {
+        return backing != Pages::Normal;
+    }
+
+    //true if the region was bound to the requested NUMA node
+    inline bool Bound() const
+    {
+        return bound;
+    }
+
+private:
+    Region ( const Region& );
+    Region& operator= ( const Region& ); // non-copyable
+    void Release();
+
+    void* data = nullptr;
+    std::size_t size = 0;
+    Pages backing = Pages::Normal;
+    bool bound = false;
+};
+}
+}
+
+#endif //LIBTRADE_MEMORY_H
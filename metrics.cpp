@@ -0,0 +1,155 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace trade
+{
+namespace metrics
+{
+namespace
+{
+//the live Latency objects, by id. ids are never reused, so a thread's table entry for a Latency that has
+//gone away is simply never looked at again
+std::mutex registry_lock;
+std::vector<Latency*> registry;
+
+thread_local std::vector<Histogram*> local_histograms;
+}
+
+Snapshot::Snapshot() : counts ( Buckets, 0 )
+{
+}
+
+void Snapshot::Merge ( const Histogram& histogram )
+{
+    for ( int i = 0; i < Buckets; i++ )
+    {
+        uint64_t n = histogram.Load ( i );
+        counts[i] += n;
+        count += n;
+    }
+    sum += histogram.Sum();
+}
+
+void Snapshot::Merge ( const Snapshot& other )
+{
+    for ( int i = 0; i < Buckets; i++ )
+    {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+Snapshot Snapshot::Since ( const Snapshot& earlier ) const
+{
+    Snapshot delta;
+    for ( int i = 0; i < Buckets; i++ )
+    {
+        delta.counts[i] = counts[i] - earlier.counts[i];
+    }
+    delta.count = count - earlier.count;
+    delta.sum = sum - earlier.sum;
+    return delta;
+}
+
+int64_t Snapshot::Percentile ( double p ) const
+{
+    if ( count == 0 )
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t> ( std::ceil ( std::min ( 100.0, std::max ( 0.0, p ) ) / 100 * count ) );
+    rank = std::max<uint64_t> ( rank, 1 );
+    uint64_t seen = 0;
+    for ( int i = 0; i < Buckets; i++ )
+    {
+        seen += counts[i];
+        if ( seen >= rank )
+        {
+            return HighestOf ( i );
+        }
+    }
+    return Max();
+}
+
+int64_t Snapshot::Min() const
+{
+    for ( int i = 0; i < Buckets; i++ )
+    {
+        if ( counts[i] != 0 )
+        {
+            return HighestOf ( i );
+        }
+    }
+    return 0;
+}
+
+int64_t Snapshot::Max() const
+{
+    for ( int i = Buckets - 1; i >= 0; i-- )
+    {
+        if ( counts[i] != 0 )
+        {
+            return HighestOf ( i );
+        }
+    }
+    return 0;
+}
+
+Latency::Latency ( std::string name ) : name ( std::move ( name ) )
+{
+    std::lock_guard<std::mutex> lk ( registry_lock );
+    id = registry.size();
+    registry.push_back ( this );
+}
+
+Latency::~Latency()
+{
+    std::lock_guard<std::mutex> lk ( registry_lock );
+    registry[id] = nullptr;
+}
+
+Histogram& Latency::Local()
+{
+    if ( id < local_histograms.size() && local_histograms[id] != nullptr )
+    {
+        return *local_histograms[id];
+    }
+    std::lock_guard<std::mutex> lk ( protect );
+    histograms.emplace_back ( new Histogram() );
+    if ( local_histograms.size() <= id )
+    {
+        local_histograms.resize ( id + 1, nullptr );
+    }
+    local_histograms[id] = histograms.back().get();
+    return *local_histograms[id];
+}
+
+Snapshot Latency::Collect() const
+{
+    Snapshot snapshot;
+    std::lock_guard<std::mutex> lk ( protect );
+    for ( const auto& histogram : histograms )
+    {
+        snapshot.Merge ( *histogram );
+    }
+    return snapshot;
+}
+
+std::vector<std::pair<std::string, Snapshot>> Latency::CollectAll()
+{
+    std::vector<std::pair<std::string, Snapshot>> all;
+    std::lock_guard<std::mutex> lk ( registry_lock );
+    for ( Latency* latency : registry )
+    {
+        if ( latency != nullptr )
+        {
+            all.emplace_back ( latency->Name(), latency->Collect() );
+        }
+    }
+    return all;
+}
+}
+}
@@ -0,0 +1,216 @@
+#ifndef LIBTRADE_METRICS_H
+#define LIBTRADE_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "clock.h"
+
+namespace trade
+{
+namespace metrics
+{
+typedef concurrent::TscClock Clock;
+
+//log linear buckets as in HdrHistogram: values below 64 get a bucket each, above that every power of two is
+//split into 64 buckets, so a bucket is never wider than 1/64 (1.6%) of its values. any unit, usually nanoseconds
+static constexpr int SubBucketBits = 6;
+static constexpr int SubBuckets = 1 << SubBucketBits;
+static constexpr int Buckets = ( 64 - SubBucketBits ) << SubBucketBits;
+
+inline int BucketOf ( int64_t value )
+{
+    if ( value < SubBuckets )
+    {
+        return value < 0 ? 0 : static_cast<int> ( value );
+    }
+    int shift = 63 - __builtin_clzll ( static_cast<uint64_t> ( value ) ) - SubBucketBits;
+    return ( ( shift + 1 ) << SubBucketBits ) + static_cast<int> ( ( value >> shift ) - SubBuckets );
+}
+
+//highest value falling into bucket
+inline int64_t HighestOf ( int bucket )
+{
+    if ( bucket < SubBuckets )
+    {
+        return bucket;
+    }
+    int shift = ( bucket >> SubBucketBits ) - 1;
+    int64_t lowest = static_cast<int64_t> ( ( bucket & ( SubBuckets - 1 ) ) + SubBuckets ) << shift;
+    return lowest + ( ( int64_t ( 1 ) << shift ) - 1 );
+}
+
+//histogram written by one thread and read by any: Record is a plain load, add and store of one counter, no
+//lock prefix and no fence, while Snapshot can merge it from another thread at any time
+class Histogram
+{
+public:
+    Histogram()
+    {
+        for ( auto& count : counts )
+        {
+            count.store ( 0, std::memory_order_relaxed );
+        }
+    }
+
+    inline void Record ( int64_t value )
+    {
+        Bump ( counts[BucketOf ( value )], 1 );
+        Bump ( sum, value );
+    }
+
+    inline uint64_t Load ( int bucket ) const
+    {
+        return counts[bucket].load ( std::memory_order_relaxed );
+    }
+
+    inline int64_t Sum() const
+    {
+        return sum.load ( std::memory_order_relaxed );
+    }
+
+private:
+    Histogram ( const Histogram& );
+    Histogram& operator= ( const Histogram& ); // non-copyable
+
+    template<class T, class U>
+    static inline void Bump ( std::atomic<T>& counter, U by )
+    {
+        counter.store ( counter.load ( std::memory_order_relaxed ) + by, std::memory_order_relaxed );
+    }
+
+    std::atomic<uint64_t> counts[Buckets];
+    std::atomic<int64_t> sum { 0 };
+};
+
+//merged counts of any number of histograms at one point in time. percentiles report the highest value of the
+//bucket they fall into, Min and Max likewise come from the buckets
+class Snapshot
+{
+public:
+    Snapshot();
+
+    void Merge ( const Histogram& histogram );
+    void Merge ( const Snapshot& other );
+
+    //what was recorded between earlier and this, e.g. the last reporting period out of two cumulative snapshots
+    Snapshot Since ( const Snapshot& earlier ) const;
+
+    //p in [0, 100], 0 if nothing was recorded
+    int64_t Percentile ( double p ) const;
+
+    int64_t Min() const;
+    int64_t Max() const;
+
+    inline uint64_t Count() const
+    {
+        return count;
+    }
+
+    inline double Mean() const
+    {
+        return count == 0 ? 0 : static_cast<double> ( sum ) / count;
+    }
+
+    inline uint64_t Load ( int bucket ) const
+    {
+        return counts[bucket];
+    }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    int64_t sum = 0;
+};
+
+//one measured quantity (a hop of the pipeline, a handler) recorded from any number of threads into
+//histograms of their own. Local() finds the calling thread's histogram through a thread local table,
+//keep the reference on hot paths. histograms of threads that have exited are kept, their counts still count
+class Latency
+{
+public:
+    explicit Latency ( std::string name );
+    ~Latency();
+
+    Histogram& Local();
+
+    inline void Record ( int64_t value )
+    {
+        Local().Record ( value );
+    }
+
+    //cumulative merge of every thread's histogram
+    Snapshot Collect() const;
+
+    inline const std::string& Name() const
+    {
+        return name;
+    }
+
+    //every live Latency with its Collect(), for a periodic reporter
+    static std::vector<std::pair<std::string, Snapshot>> CollectAll();
+
+private:
+    Latency ( const Latency& );
+    Latency& operator= ( const Latency& ); // non-copyable
+
+    std::string name;
+    std::size_t id;
+    mutable std::mutex protect;
+    std::deque<std::unique_ptr<Histogram>> histograms;
+};
+
+//records the nanoseconds between construction and destruction, ended with rdtscp so that the measured work
+//has executed before the interval closes
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency ( Histogram& histogram ) : histogram ( histogram ), start ( Clock::Ticks() )
+    {
+    }
+
+    ~ScopedLatency()
+    {
+        histogram.Record ( Clock::Elapsed ( start, Clock::TicksOrdered() ) );
+    }
+
+private:
+    ScopedLatency ( const ScopedLatency& );
+    ScopedLatency& operator= ( const ScopedLatency& ); // non-copyable
+
+    Histogram& histogram;
+    int64_t start;
+};
+
+//a message with the tsc of its enqueue, for the rings to carry when queue residency is wanted:
+//SPSCRingBuffer<Stamped<Tick>, N> and Residency() on the consumer side
+template<class T>
+struct Stamped
+{
+    T value;
+    int64_t stamp;
+};
+
+template<class T>
+inline Stamped<typename std::decay<T>::type> Stamp ( T&& value )
+{
+    return Stamped<typename std::decay<T>::type> { std::forward<T> ( value ), Clock::Ticks() };
+}
+
+//nanoseconds since the message was stamped
+template<class T>
+inline int64_t Residency ( const Stamped<T>& message )
+{
+    return Clock::Elapsed ( message.stamp, Clock::Ticks() );
+}
+}
+}
+
+#endif //LIBTRADE_METRICS_H
@@ -0,0 +1,310 @@
+#ifndef LIBTRADE_POOL_H
+#define LIBTRADE_POOL_H
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "container.h"
+#include "memory.h"
+
+namespace trade
+{
+namespace container
+{
+namespace impl
+{
+//a pooled object while it is handed out, a link of the free list while it is not
+template<class T>
+union PoolNode
+{
+    PoolNode* next;
+    typename std::aligned_storage<sizeof ( T ), alignof ( T )>::type storage;
+};
+
+//slabs of SlabSize nodes carved out of memory::Region, each new slab comes back as a free list
+template<class T, int SlabSize>
+class PoolSlabs
+{
+public:
+    typedef PoolNode<T> Node;
+
+    PoolSlabs ( bool huge_pages, bool prefault ) : huge_pages ( huge_pages ), prefault ( prefault )
+    {
+    }
+
+    Node* Grow()
+    {
+        slabs.emplace_back ( sizeof ( Node ) * SlabSize, huge_pages, prefault );
+        Node* nodes = static_cast<Node*> ( slabs.back().Data() );
+        for ( int i = 0; i < SlabSize - 1; i++ )
+        {
+            nodes[i].next = &nodes[i + 1];
+        }
+        nodes[SlabSize - 1].next = nullptr;
+        return nodes;
+    }
+
+    inline long Capacity() const
+    {
+        return static_cast<long> ( slabs.size() ) * SlabSize;
+    }
+
+private:
+    std::vector<memory::Region> slabs;
+    bool huge_pages;
+    bool prefault;
+};
+}
+
+//fixed size object pool for one thread: objects come from slabs of SlabSize, optionally on pre-faulted huge
+//pages, and freed ones are kept on a free list threaded through the objects themselves, so New/Delete
+//are a few instructions and never call malloc once the slabs are there. a new slab is mapped only when
+//every object is in use. objects still out when the pool is destroyed are not destructed
+template<class T, int SlabSize = 4096>
+class ObjectPool
+{
+public:
+    static_assert ( SlabSize > 0, "ObjectPool's slab size must be positive" );
+
+    explicit ObjectPool ( int initial_slabs = 1, bool huge_pages = false, bool prefault = true )
+        : slabs ( huge_pages, prefault )
+    {
+        for ( int i = 0; i < initial_slabs; i++ )
+        {
+            Push ( slabs.Grow() );
+        }
+    }
+
+    template<class... Args>
+    inline T* New ( Args&& ... args )
+    {
+        Node* node = Pop();
+        try
+        {
+            T* t = new ( &node->storage ) T ( std::forward<Args> ( args )... );
+            live++;
+            return t;
+        }
+        catch ( ... )
+        {
+            node->next = free_list;
+            free_list = node;
+            throw;
+        }
+    }
+
+    inline void Delete ( T* t )
+    {
+        t->~T();
+        Node* node = reinterpret_cast<Node*> ( t );
+        node->next = free_list;
+        free_list = node;
+        live--;
+    }
+
+    //objects handed out and not deleted yet
+    inline long Size() const
+    {
+        return live;
+    }
+
+    inline long Capacity() const
+    {
+        return slabs.Capacity();
+    }
+
+private:
+    typedef impl::PoolNode<T> Node;
+
+    ObjectPool ( const ObjectPool& );
+    ObjectPool& operator= ( const ObjectPool& ); // non-copyable
+
+    inline Node* Pop()
+    {
+        if ( free_list == nullptr )
+        {
+            Push ( slabs.Grow() );
+        }
+        Node* node = free_list;
+        free_list = node->next;
+        return node;
+    }
+
+    inline void Push ( Node* chain )
+    {
+        Node* last = chain;
+        while ( last->next != nullptr )
+        {
+            last = last->next;
+        }
+        last->next = free_list;
+        free_list = chain;
+    }
+
+    Node* free_list = nullptr;
+    long live = 0;
+    impl::PoolSlabs<T, SlabSize> slabs;
+};
+
+//ObjectPool whose objects may be released on other threads, e.g. allocated on the gateway thread and
+//released on the risk thread. New and Delete belong to the owning thread and work as in ObjectPool. other
+//threads push released objects onto a lock free remote list (Release, or batched through a Cache), and the
+//owner takes that list over in one exchange when its own free list runs dry
+template<class T, int SlabSize = 4096>
+class ConcurrentObjectPool
+{
+    typedef impl::PoolNode<T> Node;
+
+public:
+    static_assert ( SlabSize > 0, "ConcurrentObjectPool's slab size must be positive" );
+
+    //per thread batch of released objects, handed back to the pool with a single CAS once Batch are
+    //collected, on Flush and on destruction. not to be shared between threads
+    class Cache
+    {
+    public:
+        explicit Cache ( ConcurrentObjectPool& pool, int batch = 64 ) : pool ( pool ), batch ( batch )
+        {
+        }
+
+        ~Cache()
+        {
+            Flush();
+        }
+
+        inline void Release ( T* t )
+        {
+            t->~T();
+            Node* node = reinterpret_cast<Node*> ( t );
+            node->next = first;
+            first = node;
+            if ( last == nullptr )
+            {
+                last = node;
+            }
+            if ( ++count >= batch )
+            {
+                Flush();
+            }
+        }
+
+        inline void Flush()
+        {
+            if ( first != nullptr )
+            {
+                pool.PushRemote ( first, last );
+                first = last = nullptr;
+                count = 0;
+            }
+        }
+
+    private:
+        Cache ( const Cache& );
+        Cache& operator= ( const Cache& ); // non-copyable
+        ConcurrentObjectPool& pool;
+        Node* first = nullptr;
+        Node* last = nullptr;
+        int count = 0;
+        int batch;
+    };
+
+    explicit ConcurrentObjectPool ( int initial_slabs = 1, bool huge_pages = false, bool prefault = true )
+        : remote ( nullptr ), slabs ( huge_pages, prefault )
+    {
+        for ( int i = 0; i < initial_slabs; i++ )
+        {
+            Node* chain = slabs.Grow();
+            Node* last = chain;
+            while ( last->next != nullptr )
+            {
+                last = last->next;
+            }
+            last->next = free_list;
+            free_list = chain;
+        }
+    }
+
+    //owner thread only
+    template<class... Args>
+    inline T* New ( Args&& ... args )
+    {
+        Node* node = Pop();
+        try
+        {
+            return new ( &node->storage ) T ( std::forward<Args> ( args )... );
+        }
+        catch ( ... )
+        {
+            node->next = free_list;
+            free_list = node;
+            throw;
+        }
+    }
+
+    //owner thread only
+    inline void Delete ( T* t )
+    {
+        t->~T();
+        Node* node = reinterpret_cast<Node*> ( t );
+        node->next = free_list;
+        free_list = node;
+    }
+
+    //any thread
+    inline void Release ( T* t )
+    {
+        t->~T();
+        Node* node = reinterpret_cast<Node*> ( t );
+        PushRemote ( node, node );
+    }
+
+    //owner thread only
+    inline long Capacity() const
+    {
+        return slabs.Capacity();
+    }
+
+private:
+    ConcurrentObjectPool ( const ConcurrentObjectPool& );
+    ConcurrentObjectPool& operator= ( const ConcurrentObjectPool& ); // non-copyable
+
+    inline Node* Pop()
+    {
+        if ( free_list == nullptr )
+        {
+            //push only by others and take all by the owner, so there is no ABA on remote
+            free_list = remote.exchange ( nullptr, std::memory_order_acquire );
+            if ( free_list == nullptr )
+            {
+                free_list = slabs.Grow();
+            }
+        }
+        Node* node = free_list;
+        free_list = node->next;
+        return node;
+    }
+
+    inline void PushRemote ( Node* first, Node* last )
+    {
+        Node* head = remote.load ( std::memory_order_relaxed );
+        do
+        {
+            last->next = head;
+        }
+        while ( !remote.compare_exchange_weak ( head, first, std::memory_order_release, std::memory_order_relaxed ) );
+    }
+
+    impl::cacheline_pad_t pad0;
+    Node* free_list = nullptr;
+    impl::cacheline_pad_t pad1;
+    std::atomic<Node*> remote;
+    impl::cacheline_pad_t pad2;
+    impl::PoolSlabs<T, SlabSize> slabs;
+};
+}
+}
+
+#endif //LIBTRADE_POOL_H
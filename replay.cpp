@@ -0,0 +1,46 @@
+#include "replay.h"
+
+namespace trade
+{
+namespace journal
+{
+Replay::Replay()
+{
+}
+
+Replay::~Replay()
+{
+}
+
+int Replay::Add ( const std::string& directory, const std::string& name )
+{
+    int stream = static_cast<int> ( readers.size() );
+    readers.emplace_back ( new Reader ( directory, name ) );
+    Head head;
+    head.stream = stream;
+    if ( readers.back()->Next ( head.record ) )
+    {
+        head.timestamp = head.record.Timestamp();
+        heap.push_back ( head );
+        SiftUp ( heap.size() - 1 );
+    }
+    return stream;
+}
+
+void Replay::SiftUp ( std::size_t i )
+{
+    Head moving = heap[i];
+    while ( i > 0 )
+    {
+        std::size_t parent = ( i - 1 ) / 2;
+        if ( !Before ( moving, heap[parent] ) )
+        {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = moving;
+}
+}
+}
@@ -0,0 +1,225 @@
+#ifndef LIBTRADE_REPLAY_H
+#define LIBTRADE_REPLAY_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clock.h"
+#include "concurrent.h"
+#include "journal.h"
+
+namespace trade
+{
+namespace journal
+{
+//feeds recorded journals back in timestamp order, merging any number of them with a k-way heap of their next
+//records. ties go to the stream added first, then to journal order, so a replay of the same journals always
+//delivers the same sequence. records are handed out in place from the readers' mapped segments, nothing is
+//parsed or copied on the way. a sink is called as sink(const Record&, int stream) and is valid until it returns.
+//three ways to drive it: Run() as fast as possible, RunPaced() on the wall clock at the recorded intervals, and
+//Step()/RunUntil() under the caller's control, e.g. a backtest's simulated clock. single threaded
+class Replay
+{
+public:
+    Replay();
+    ~Replay();
+
+    //the journal name in directory as the next stream, returns its number. throws std::runtime_error if there
+    //is no such journal
+    int Add ( const std::string& directory, const std::string& name );
+
+    inline bool Done() const
+    {
+        return heap.empty();
+    }
+
+    //timestamp of the record Step() delivers next, only valid unless Done()
+    inline int64_t NextTimestamp() const
+    {
+        return heap[0].timestamp;
+    }
+
+    //records delivered so far
+    inline long Delivered() const
+    {
+        return delivered;
+    }
+
+    //deliver the next record, false once every stream is exhausted
+    template<class TFunc>
+    inline bool Step ( const TFunc& sink )
+    {
+        if ( heap.empty() )
+        {
+            return false;
+        }
+        Deliver ( sink );
+        return true;
+    }
+
+    //deliver every record stamped up to and including timestamp, returns how many
+    template<class TFunc>
+    inline long RunUntil ( int64_t timestamp, const TFunc& sink )
+    {
+        long count = 0;
+        while ( !heap.empty() && heap[0].timestamp <= timestamp )
+        {
+            Deliver ( sink );
+            count++;
+        }
+        return count;
+    }
+
+    //deliver everything as fast as the sink takes it, returns how many
+    template<class TFunc>
+    inline long Run ( const TFunc& sink )
+    {
+        long count = 0;
+        while ( !heap.empty() )
+        {
+            Deliver ( sink );
+            count++;
+        }
+        return count;
+    }
+
+    //deliver everything with the recorded gaps between records divided by speed, on TscClock from the first
+    //record on. sleeps through gaps of more than a millisecond and spins the rest, so records go out within
+    //a microsecond or so of their due time. a sink slower than the recording falls behind and catches up
+    //without pausing. returns how many
+    template<class TFunc>
+    inline long RunPaced ( const TFunc& sink, double speed = 1.0 )
+    {
+        if ( heap.empty() )
+        {
+            return 0;
+        }
+        int64_t first = heap[0].timestamp;
+        int64_t start = concurrent::TscClock::Now();
+        long count = 0;
+        while ( !heap.empty() )
+        {
+            int64_t due = start + static_cast<int64_t> ( ( heap[0].timestamp - first ) / speed );
+            int64_t wait = due - concurrent::TscClock::Now();
+            if ( wait > 1000000 )
+            {
+                std::this_thread::sleep_for ( std::chrono::nanoseconds ( wait - 500000 ) );
+            }
+            while ( concurrent::TscClock::Now() < due )
+            {
+                concurrent::CpuRelax();
+            }
+            Deliver ( sink );
+            count++;
+        }
+        return count;
+    }
+
+private:
+    Replay ( const Replay& );
+    Replay& operator= ( const Replay& ); // non-copyable
+
+    struct Head
+    {
+        int64_t timestamp;
+        int stream;
+        Record record;
+    };
+
+    static inline bool Before ( const Head& a, const Head& b )
+    {
+        return a.timestamp < b.timestamp || ( a.timestamp == b.timestamp && a.stream < b.stream );
+    }
+
+    //hand out the top record, then refill the top from the same stream and sift it down: one pass down
+    //the heap a record instead of a pop and a push
+    template<class TFunc>
+    inline void Deliver ( const TFunc& sink )
+    {
+        Head& top = heap[0];
+        sink ( static_cast<const Record&> ( top.record ), top.stream );
+        delivered++;
+        if ( readers[top.stream]->Next ( top.record ) )
+        {
+            top.timestamp = top.record.Timestamp();
+        }
+        else
+        {
+            top = heap.back();
+            heap.pop_back();
+        }
+        if ( heap.size() > 1 )
+        {
+            SiftDown();
+        }
+    }
+
+    inline void SiftDown()
+    {
+        std::size_t size = heap.size();
+        std::size_t i = 0;
+        Head moving = heap[0];
+        while ( true )
+        {
+            std::size_t child = 2 * i + 1;
+            if ( child >= size )
+            {
+                break;
+            }
+            if ( child + 1 < size && Before ( heap[child + 1], heap[child] ) )
+            {
+                child++;
+            }
+            if ( !Before ( heap[child], moving ) )
+            {
+                break;
+            }
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = moving;
+    }
+
+    void SiftUp ( std::size_t i );
+
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::vector<Head> heap;
+    long delivered = 0;
+};
+
+//a sink enqueueing the records of one type into a ring as T, e.g. Replay::Run ( IntoRing<Tick> ( ring, 1 ) )
+//to push recorded ticks through the production pipeline. records of other types are passed over
+template<class T, class TRing>
+class RingSink
+{
+public:
+    RingSink ( TRing& ring, uint16_t type ) : ring ( ring ), type ( type )
+    {
+    }
+
+    inline void operator() ( const Record& record, int ) const
+    {
+        if ( record.Type() == type )
+        {
+            ring.Enqueue ( record.As<T>() );
+        }
+    }
+
+private:
+    TRing& ring;
+    uint16_t type;
+};
+
+template<class T, class TRing>
+inline RingSink<T, TRing> IntoRing ( TRing& ring, uint16_t type )
+{
+    return RingSink<T, TRing> ( ring, type );
+}
+}
+}
+
+#endif //LIBTRADE_REPLAY_H
@@ -0,0 +1,191 @@
+#include "runtime.h"
+
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace trade
+{
+namespace concurrent
+{
+namespace
+{
+//isolated cpus handed to workers, so that two AnyIsolated workers never share one
+std::mutex reserved_lock;
+std::set<int> reserved;
+
+int ReserveIsolatedCpu()
+{
+    std::lock_guard<std::mutex> lk ( reserved_lock );
+    for ( int cpu : IsolatedCpus() )
+    {
+        if ( reserved.insert ( cpu ).second )
+        {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+void ReleaseCpu ( int cpu )
+{
+    std::lock_guard<std::mutex> lk ( reserved_lock );
+    reserved.erase ( cpu );
+}
+}
+
+std::vector<int> ParseCpuList ( const std::string& list )
+{
+    std::vector<int> cpus;
+    std::stringstream in ( list );
+    std::string range;
+    while ( std::getline ( in, range, ',' ) )
+    {
+        if ( range.empty() || range.find_first_not_of ( " \n" ) == std::string::npos )
+        {
+            continue;
+        }
+        std::size_t dash = range.find ( '-' );
+        int first = std::stoi ( range.substr ( 0, dash ) );
+        int last = dash == std::string::npos ? first : std::stoi ( range.substr ( dash + 1 ) );
+        for ( int cpu = first; cpu <= last; cpu++ )
+        {
+            cpus.push_back ( cpu );
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> IsolatedCpus()
+{
+    std::ifstream in ( "/sys/devices/system/cpu/isolated" );
+    std::string list;
+    std::getline ( in, list );
+    return ParseCpuList ( list );
+}
+
+bool PinThread ( int cpu )
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO ( &set );
+    CPU_SET ( cpu, &set );
+    return pthread_setaffinity_np ( pthread_self(), sizeof ( set ), &set ) == 0;
+#else
+    ( void ) cpu;
+    return false;
+#endif
+}
+
+bool SetFifoPriority ( int priority )
+{
+#if defined(__linux__)
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam ( pthread_self(), SCHED_FIFO, &param ) == 0;
+#else
+    ( void ) priority;
+    return false;
+#endif
+}
+
+void SetThreadName ( const std::string& name )
+{
+#if defined(__linux__)
+    pthread_setname_np ( pthread_self(), name.substr ( 0, 15 ).c_str() );
+#else
+    ( void ) name;
+#endif
+}
+
+WorkerThread::WorkerThread ( WorkerOptions options ) : options ( std::move ( options ) ),
+    timers ( this->options.timer_resolution ), running ( false ), ready ( false )
+{
+}
+
+WorkerThread::~WorkerThread()
+{
+    Stop();
+}
+
+void WorkerThread::Start()
+{
+    if ( thread.joinable() )
+    {
+        return;
+    }
+    ready.store ( false, std::memory_order_relaxed );
+    running.store ( true, std::memory_order_release );
+    thread = std::thread ( [this]
+    {
+        Run();
+    } );
+    while ( !ready.load ( std::memory_order_acquire ) )
+    {
+        std::this_thread::yield();
+    }
+}
+
+void WorkerThread::Stop()
+{
+    running.store ( false, std::memory_order_release );
+    if ( thread.joinable() )
+    {
+        thread.join();
+    }
+    if ( reserved_cpu >= 0 )
+    {
+        ReleaseCpu ( reserved_cpu );
+        reserved_cpu = -1;
+    }
+}
+
+void WorkerThread::Run()
+{
+    int wanted = options.cpu;
+    if ( wanted == WorkerOptions::AnyIsolated )
+    {
+        wanted = reserved_cpu = ReserveIsolatedCpu();
+    }
+    cpu = wanted >= 0 && PinThread ( wanted ) ? wanted : -1;
+    real_time = options.fifo_priority > 0 && SetFifoPriority ( options.fifo_priority );
+    if ( !options.name.empty() )
+    {
+        SetThreadName ( options.name );
+    }
+    OnStart();
+    ready.store ( true, std::memory_order_release );
+
+    while ( running.load ( std::memory_order_acquire ) )
+    {
+        long done = Poll();
+        if ( !timers.Empty() )
+        {
+            done += timers.Poll();
+        }
+        if ( done == 0 )
+        {
+            if ( options.yield_when_idle )
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                CpuRelax();
+            }
+        }
+    }
+    //whatever was posted before Stop() is still handled
+    while ( Poll() > 0 )
+    {
+    }
+    OnStop();
+}
+}
+}
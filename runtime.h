@@ -0,0 +1,174 @@
+#ifndef LIBTRADE_RUNTIME_H
+#define LIBTRADE_RUNTIME_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "container.h"
+#include "timer.h"
+
+namespace trade
+{
+namespace concurrent
+{
+//"0-3,8,10-11" -> 0 1 2 3 8 10 11, the format of isolcpus= and of /sys/devices/system/cpu/*
+std::vector<int> ParseCpuList ( const std::string& list );
+
+//cpus taken away from the scheduler with isolcpus=, read from /sys/devices/system/cpu/isolated
+std::vector<int> IsolatedCpus();
+
+//the calling thread only. false if the os refused
+bool PinThread ( int cpu );
+bool SetFifoPriority ( int priority ); // SCHED_FIFO, needs CAP_SYS_NICE
+void SetThreadName ( const std::string& name ); // cut to 15 characters on linux
+
+struct WorkerOptions
+{
+    //take the first isolated cpu no other worker has taken
+    static constexpr int AnyIsolated = -2;
+
+    std::string name;
+    int cpu = -1; // -1 leaves the thread to the scheduler
+    //> 0 runs the loop SCHED_FIFO at that priority. a busy polling FIFO thread never gives its cpu back,
+    //so only ask for it on a cpu nothing else runs on (isolated, or AnyIsolated)
+    int fifo_priority = 0;
+    bool yield_when_idle = false; // pause (false) or give the cpu away (true) when a poll found nothing
+    int64_t timer_resolution = 1000; // nanoseconds a tick of the loop's timer wheel
+};
+
+//a named thread running a busy poll loop: Poll(), then advance the timer wheel, again. the thread pins itself,
+//raises its priority and names itself before the first poll, and Start() returns once that is done.
+//derived classes must call Stop() in their destructor, before their members go away
+class WorkerThread
+{
+public:
+    explicit WorkerThread ( WorkerOptions options );
+    virtual ~WorkerThread();
+
+    void Start();
+    void Stop();
+
+    inline bool Running() const
+    {
+        return running.load ( std::memory_order_acquire );
+    }
+
+    inline const std::string& Name() const
+    {
+        return options.name;
+    }
+
+    //the cpu the thread runs on, -1 if it is not pinned (not asked for, none isolated left, or refused)
+    inline int Cpu() const
+    {
+        return cpu;
+    }
+
+    inline bool RealTime() const
+    {
+        return real_time;
+    }
+
+    //loop thread only, or before Start()
+    inline TimerWheel<>& Timers()
+    {
+        return timers;
+    }
+
+protected:
+    //handle whatever is pending, returns how much was done
+    virtual long Poll() = 0;
+
+    virtual void OnStart()
+    {
+    }
+
+    virtual void OnStop()
+    {
+    }
+
+private:
+    WorkerThread ( const WorkerThread& );
+    WorkerThread& operator= ( const WorkerThread& ); // non-copyable
+    void Run();
+
+    WorkerOptions options;
+    TimerWheel<> timers;
+    std::thread thread;
+    std::atomic_bool running;
+    std::atomic_bool ready;
+    int cpu = -1;
+    int reserved_cpu = -1;
+    bool real_time = false;
+};
+
+//worker handling TMessage posted to its SPSC inbox. one thread posts to a worker: a pipeline is a chain of
+//workers each posting to the next (feed -> strategy -> gateway), fan in goes through several inboxes
+template<class TMessage, int N = 4096>
+class Worker : public WorkerThread
+{
+public:
+    typedef std::function<void ( TMessage& )> Handler;
+
+    Worker ( WorkerOptions options, Handler handler ) : WorkerThread ( std::move ( options ) ), handler ( std::move ( handler ) )
+    {
+    }
+
+    ~Worker()
+    {
+        Stop();
+    }
+
+    //false if the inbox is full
+    inline bool TryPost ( const TMessage& message )
+    {
+        return inbox.TryEnqueue ( message );
+    }
+
+    inline bool TryPost ( TMessage&& message )
+    {
+        return inbox.TryEnqueue ( std::move ( message ) );
+    }
+
+    //spin while the inbox is full
+    inline void Post ( const TMessage& message )
+    {
+        inbox.Enqueue ( message );
+    }
+
+    inline void Post ( TMessage&& message )
+    {
+        inbox.Enqueue ( std::move ( message ) );
+    }
+
+    inline int Pending() const
+    {
+        return inbox.Size();
+    }
+
+protected:
+    long Poll() override
+    {
+        return inbox.DequeueBatch ( [this] ( TMessage * messages, long count )
+        {
+            for ( long i = 0; i < count; i++ )
+            {
+                handler ( messages[i] );
+            }
+        } );
+    }
+
+private:
+    Handler handler;
+    container::SPSCRingBuffer<TMessage, N, BusySpinWait, container::FullPolicy::Spin> inbox;
+};
+}
+}
+
+#endif //LIBTRADE_RUNTIME_H
@@ -0,0 +1,378 @@
+#ifndef LIBTRADE_SERIES_H
+#define LIBTRADE_SERIES_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "container.h"
+
+namespace trade
+{
+namespace series
+{
+//one column of a series: the last N values in contiguous, cache line aligned storage, addressed by
+//absolute index like CircularArray but without locks or a consumer side. single writer
+template<class T, int N>
+class Column
+{
+public:
+    static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                    "Column's size must be a positive power of 2" );
+
+    typedef T value_type;
+
+    inline void Push ( const T& t )
+    {
+        data[head & mask] = t;
+        head++;
+    }
+
+    //absolute index, valid for [Begin(), End())
+    inline const T& operator [] ( long i ) const
+    {
+        return data[i & mask];
+    }
+
+    inline const T& Latest() const
+    {
+        return data[ ( head - 1 ) & mask];
+    }
+
+    //oldest index still held
+    inline long Begin() const
+    {
+        return std::max ( 0L, head - N );
+    }
+
+    inline long End() const
+    {
+        return head;
+    }
+
+    inline long Size() const
+    {
+        return std::min<long> ( head, N );
+    }
+
+    //hand action(const T* first, long n) the values of [first, last) as at most two contiguous spans
+    template<class TFunc>
+    inline void Spans ( long first, long last, const TFunc& action ) const
+    {
+        assert ( first >= Begin() && last <= End() );
+        long count = last - first;
+        if ( count <= 0 )
+        {
+            return;
+        }
+        long pos = first & mask;
+        long part = std::min<long> ( count, N - pos );
+        action ( &data[pos], part );
+        if ( count > part )
+        {
+            action ( &data[0], count - part );
+        }
+    }
+
+    inline void Clear()
+    {
+        head = 0;
+    }
+
+    static constexpr long Capacity()
+    {
+        return N;
+    }
+
+private:
+    alignas ( container::impl::cacheline_size ) T data[N];
+    long head = 0;
+    static constexpr long mask = N - 1;
+};
+
+//recent ticks as a structure of arrays: a signal scanning prices only streams the price column instead of
+//dragging timestamps, sizes and sides through the cache with it
+template<int N, class TPrice = double, class TSize = double>
+class TickWindow
+{
+public:
+    enum Side : int8_t
+    {
+        Buy = 1,
+        Unknown = 0,
+        Sell = -1
+    };
+
+    inline void Append ( int64_t time, TPrice p, TSize s, int8_t aggressor = Unknown )
+    {
+        timestamp.Push ( time );
+        price.Push ( p );
+        size.Push ( s );
+        side.Push ( aggressor );
+    }
+
+    inline long Begin() const
+    {
+        return price.Begin();
+    }
+
+    inline long End() const
+    {
+        return price.End();
+    }
+
+    inline long Size() const
+    {
+        return price.Size();
+    }
+
+    inline void Clear()
+    {
+        timestamp.Clear();
+        price.Clear();
+        size.Clear();
+        side.Clear();
+    }
+
+    Column<int64_t, N> timestamp;
+    Column<TPrice, N> price;
+    Column<TSize, N> size;
+    Column<int8_t, N> side;
+};
+
+//the rolling aggregates below follow a column over its last Window values. call Update() once after every
+//push, it takes the new value in and the one that just left the window out in O(1). Window must stay below
+//the column's capacity: the value leaving the window is read back from the column, and with a window of N
+//its slot already holds the new value. RollingExtreme only reads values inside the window and may take N
+
+template<class T, int N, class TSum = T>
+class RollingSum
+{
+public:
+    RollingSum ( const Column<T, N>& column, long window ) : column ( column ), window ( window )
+    {
+        assert ( window > 0 && window < N );
+    }
+
+    inline void Update()
+    {
+        long end = column.End();
+        sum += column[end - 1];
+        if ( end > window )
+        {
+            sum -= column[end - 1 - window];
+        }
+    }
+
+    inline TSum Sum() const
+    {
+        return sum;
+    }
+
+    inline long Count() const
+    {
+        return std::min ( column.End(), window );
+    }
+
+    inline double Mean() const
+    {
+        return Count() == 0 ? 0 : static_cast<double> ( sum ) / Count();
+    }
+
+    //recompute from the column, floating point sums drift after many updates
+    inline void Rebuild()
+    {
+        sum = TSum();
+        for ( long i = column.End() - Count(); i < column.End(); i++ )
+        {
+            sum += column[i];
+        }
+    }
+
+private:
+    const Column<T, N>& column;
+    long window;
+    TSum sum = TSum();
+};
+
+//volume weighted average price over the last Window ticks
+template<class TPrice, class TSize, int N>
+class RollingVwap
+{
+public:
+    RollingVwap ( const Column<TPrice, N>& price, const Column<TSize, N>& size, long window )
+        : price ( price ), size ( size ), window ( window )
+    {
+        assert ( window > 0 && window < N );
+    }
+
+    inline void Update()
+    {
+        long end = price.End();
+        notional += static_cast<double> ( price[end - 1] ) * size[end - 1];
+        volume += size[end - 1];
+        if ( end > window )
+        {
+            notional -= static_cast<double> ( price[end - 1 - window] ) * size[end - 1 - window];
+            volume -= size[end - 1 - window];
+        }
+    }
+
+    inline double Vwap() const
+    {
+        return volume == 0 ? 0 : notional / volume;
+    }
+
+    inline double Volume() const
+    {
+        return volume;
+    }
+
+    inline void Rebuild()
+    {
+        notional = volume = 0;
+        for ( long i = price.End() - std::min ( price.End(), window ); i < price.End(); i++ )
+        {
+            notional += static_cast<double> ( price[i] ) * size[i];
+            volume += size[i];
+        }
+    }
+
+private:
+    const Column<TPrice, N>& price;
+    const Column<TSize, N>& size;
+    long window;
+    double notional = 0;
+    double volume = 0;
+};
+
+//min or max over the last Window values with a monotonic deque of indices: every value enters and leaves
+//the deque once, so Update is amortised O(1) and the extreme is always at the front
+template<class T, int N, class TCompare>
+class RollingExtreme
+{
+public:
+    RollingExtreme ( const Column<T, N>& column, long window ) : column ( column ), window ( window )
+    {
+        assert ( window > 0 && window <= N );
+        long capacity = 1;
+        while ( capacity < window + 1 )
+        {
+            capacity <<= 1;
+        }
+        indices.resize ( capacity );
+        mask = capacity - 1;
+    }
+
+    inline void Update()
+    {
+        long i = column.End() - 1;
+        const T& value = column[i];
+        while ( back > front && !compare ( column[indices[ ( back - 1 ) & mask]], value ) )
+        {
+            back--;
+        }
+        indices[back++ & mask] = i;
+        if ( indices[front & mask] <= i - window )
+        {
+            front++;
+        }
+    }
+
+    //only defined once something has been pushed
+    inline const T& Value() const
+    {
+        return column[indices[front & mask]];
+    }
+
+    inline long Index() const
+    {
+        return indices[front & mask];
+    }
+
+private:
+    const Column<T, N>& column;
+    long window;
+    std::vector<long> indices;
+    long mask;
+    long front = 0;
+    long back = 0;
+    TCompare compare;
+};
+
+template<class T, int N>
+using RollingMin = RollingExtreme<T, N, std::less<T>>;
+
+template<class T, int N>
+using RollingMax = RollingExtreme<T, N, std::greater<T>>;
+
+//mean and variance over the last Window values, Welford's update extended to take the leaving value out
+template<class T, int N>
+class RollingVariance
+{
+public:
+    RollingVariance ( const Column<T, N>& column, long window ) : column ( column ), window ( window )
+    {
+        assert ( window > 0 && window < N );
+    }
+
+    inline void Update()
+    {
+        long end = column.End();
+        double x = static_cast<double> ( column[end - 1] );
+        if ( end <= window )
+        {
+            count++;
+            double delta = x - mean;
+            mean += delta / count;
+            m2 += delta * ( x - mean );
+            return;
+        }
+        double y = static_cast<double> ( column[end - 1 - window] );
+        double previous = mean;
+        mean += ( x - y ) / count;
+        m2 += ( x - y ) * ( x - mean + y - previous );
+    }
+
+    inline double Mean() const
+    {
+        return mean;
+    }
+
+    //sample variance
+    inline double Variance() const
+    {
+        return count > 1 ? std::max ( 0.0, m2 / ( count - 1 ) ) : 0;
+    }
+
+    inline long Count() const
+    {
+        return count;
+    }
+
+    inline void Rebuild()
+    {
+        count = 0;
+        mean = m2 = 0;
+        for ( long i = column.End() - std::min ( column.End(), window ); i < column.End(); i++ )
+        {
+            double x = static_cast<double> ( column[i] );
+            count++;
+            double delta = x - mean;
+            mean += delta / count;
+            m2 += delta * ( x - mean );
+        }
+    }
+
+private:
+    const Column<T, N>& column;
+    long window;
+    long count = 0;
+    double mean = 0;
+    double m2 = 0;
+};
+}
+}
+
+#endif //LIBTRADE_SERIES_H
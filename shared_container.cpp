@@ -0,0 +1,66 @@
+#include "shared_container.h"
+
+#include <stdexcept>
+
+namespace trade
+{
+namespace container
+{
+namespace impl
+{
+SharedRingSegment::SharedRingSegment ( const std::string& name, bool create, uint32_t element_size, uint32_t capacity,
+                                       bool multi_producer, std::size_t data_size )
+{
+    using namespace boost::interprocess;
+    std::size_t size = DataOffset() + data_size;
+    if ( create )
+    {
+        shared_memory_object::remove ( name.c_str() );
+        shared_memory_object created ( create_only, name.c_str(), read_write );
+        created.truncate ( size );
+        shm.swap ( created );
+        mapped_region mapped ( shm, read_write, 0, size );
+        region.swap ( mapped );
+        header = new ( region.get_address() ) SharedRingHeader();
+        header->magic = SharedRingHeader::Magic;
+        header->version = SharedRingHeader::Version;
+        header->element_size = element_size;
+        header->capacity = capacity;
+        header->multi_producer = multi_producer ? 1 : 0;
+        header->head.store ( 0, std::memory_order_relaxed );
+        header->tail.store ( 0, std::memory_order_relaxed );
+        header->initialized.store ( 0, std::memory_order_relaxed );
+        return;
+    }
+
+    shared_memory_object opened ( open_only, name.c_str(), read_write );
+    shm.swap ( opened );
+    mapped_region mapped ( shm, read_write );
+    region.swap ( mapped );
+    if ( region.get_size() < size )
+    {
+        throw std::runtime_error ( "shared ring " + name + " is smaller than expected" );
+    }
+    header = static_cast<SharedRingHeader*> ( region.get_address() );
+    if ( header->initialized.load ( std::memory_order_acquire ) != 1 )
+    {
+        throw std::runtime_error ( "shared ring " + name + " is not initialized yet" );
+    }
+    if ( header->magic != SharedRingHeader::Magic || header->version != SharedRingHeader::Version )
+    {
+        throw std::runtime_error ( "shared ring " + name + " has an unknown header version" );
+    }
+    if ( header->element_size != element_size || header->capacity != capacity
+            || header->multi_producer != ( multi_producer ? 1u : 0u ) )
+    {
+        throw std::runtime_error ( "shared ring " + name + " was created with a different layout" );
+    }
+}
+
+bool SharedRingSegment::Remove ( const std::string& name )
+{
+    return boost::interprocess::shared_memory_object::remove ( name.c_str() );
+}
+}
+}
+}
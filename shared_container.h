@@ -0,0 +1,320 @@
+#ifndef LIBTRADE_SHARED_CONTAINER_H
+#define LIBTRADE_SHARED_CONTAINER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "concurrent.h"
+#include "container.h"
+
+namespace trade
+{
+namespace container
+{
+namespace impl
+{
+static_assert ( ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                "shared rings need address free lock free atomics" );
+
+//first bytes of every shared ring segment. the rest of the segment is addressed by offset, never by
+//pointer, so every process may map it at a different address
+struct SharedRingHeader
+{
+    static constexpr uint32_t Magic = 0x5253544c; // "LTSR"
+    static constexpr uint32_t Version = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t element_size;
+    uint32_t capacity;
+    uint32_t multi_producer;
+    std::atomic<uint32_t> initialized;
+    cacheline_pad_t pad0;
+    std::atomic<int64_t> head;
+    cacheline_pad_t pad1;
+    std::atomic<int64_t> tail;
+    cacheline_pad_t pad2;
+    concurrent::SharedBlockingWait waiter;
+    cacheline_pad_t pad3;
+};
+
+//maps a named shared memory segment (shm_open + mmap on posix) holding a SharedRingHeader followed by the
+//ring data. the creator initialises the header and calls Publish() once the ring data is ready, openers
+//check that it describes the same ring layout and throw std::runtime_error otherwise
+class SharedRingSegment
+{
+public:
+    SharedRingSegment ( const std::string& name, bool create, uint32_t element_size, uint32_t capacity,
+                        bool multi_producer, std::size_t data_size );
+
+    inline SharedRingHeader* Header() const
+    {
+        return header;
+    }
+
+    inline char* Data() const
+    {
+        return static_cast<char*> ( region.get_address() ) + DataOffset();
+    }
+
+    //let openers in, to be called by the creator once the ring data is initialised
+    inline void Publish()
+    {
+        header->initialized.store ( 1, std::memory_order_release );
+    }
+
+    static constexpr std::size_t DataOffset()
+    {
+        return ( sizeof ( SharedRingHeader ) + cacheline_size - 1 ) / cacheline_size * cacheline_size;
+    }
+
+    static bool Remove ( const std::string& name );
+
+private:
+    SharedRingSegment ( const SharedRingSegment& );
+    SharedRingSegment& operator= ( const SharedRingSegment& ); // non-copyable
+    boost::interprocess::shared_memory_object shm;
+    boost::interprocess::mapped_region region;
+    SharedRingHeader* header = nullptr;
+};
+}
+
+//SPSC ring placed in a named shared memory segment so that two processes exchange elements without a
+//socket hop. one side constructs it with create = true, the other opens it with create = false.
+//never overwrites: TryEnqueue returns false when full, Enqueue spins. DequeueWait sleeps on a
+//SharedAutoResetEvent in the segment, and producers only pay for the wake up while a consumer sleeps
+template<class T, int N>
+class SharedSPSCRingBuffer
+{
+public:
+    static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                    "SharedSPSCRingBuffer's size must be a positive power of 2" );
+    static_assert ( std::is_trivially_copyable<T>::value,
+                    "SharedSPSCRingBuffer's element must be trivially copyable" );
+
+    SharedSPSCRingBuffer ( const std::string& name, bool create )
+        : segment ( name, create, sizeof ( T ), N, false, sizeof ( T ) * N ),
+          header ( segment.Header() ),
+          buffer ( reinterpret_cast<T*> ( segment.Data() ) )
+    {
+        if ( create )
+        {
+            segment.Publish();
+        }
+    }
+
+    inline bool TryEnqueue ( const T& t )
+    {
+        int64_t current_head = header->head.load ( std::memory_order_relaxed );
+        if ( current_head - cached_tail >= N )
+        {
+            cached_tail = header->tail.load ( std::memory_order_acquire );
+            if ( current_head - cached_tail >= N )
+            {
+                return false;
+            }
+        }
+        buffer[current_head & mask] = t;
+        header->head.store ( current_head + 1, std::memory_order_release );
+        header->waiter.Signal();
+        return true;
+    }
+
+    inline void Enqueue ( const T& t )
+    {
+        while ( !TryEnqueue ( t ) )
+        {
+            concurrent::CpuRelax();
+        }
+    }
+
+    //drain every available element, returns the number read
+    template<class TFunc>
+    inline long Dequeue ( const TFunc& action )
+    {
+        int64_t current_tail = header->tail.load ( std::memory_order_relaxed );
+        int64_t current_head = header->head.load ( std::memory_order_acquire );
+        for ( int64_t i = current_tail; i < current_head; i++ )
+        {
+            action ( buffer[i & mask] );
+        }
+        if ( current_head > current_tail )
+        {
+            header->tail.store ( current_head, std::memory_order_release );
+        }
+        return current_head - current_tail;
+    }
+
+    template<class TFunc>
+    inline bool DequeueWait ( const TFunc& action, int timeout )
+    {
+        auto ready = [this]
+        {
+            return header->tail.load ( std::memory_order_relaxed ) < header->head.load ( std::memory_order_acquire );
+        };
+        if ( !header->waiter.Wait ( ready, timeout ) )
+        {
+            return false;
+        }
+        Dequeue ( action );
+        return true;
+    }
+
+    inline int Size() const
+    {
+        return header->head.load ( std::memory_order_acquire ) - header->tail.load ( std::memory_order_acquire );
+    }
+
+    inline long Capacity() const
+    {
+        return N;
+    }
+
+    static bool Remove ( const std::string& name )
+    {
+        return impl::SharedRingSegment::Remove ( name );
+    }
+
+private:
+    impl::SharedRingSegment segment;
+    impl::SharedRingHeader* header;
+    T* buffer;
+    int64_t cached_tail = 0;
+    int64_t mask = N - 1;
+};
+
+//MPSC variant: producers in any number of processes claim slots by CAS on head, every slot carries a
+//sequence number (stored after the elements) telling whether it is free or published
+template<class T, int N>
+class SharedMPSCRingBuffer
+{
+public:
+    static_assert ( ( ( N > 0 ) && ( ( N & ( ~N + 1 ) ) == N ) ),
+                    "SharedMPSCRingBuffer's size must be a positive power of 2" );
+    static_assert ( std::is_trivially_copyable<T>::value,
+                    "SharedMPSCRingBuffer's element must be trivially copyable" );
+
+    SharedMPSCRingBuffer ( const std::string& name, bool create )
+        : segment ( name, create, sizeof ( T ), N, true, SequenceOffset() + sizeof ( std::atomic<int64_t> ) * N ),
+          header ( segment.Header() ),
+          buffer ( reinterpret_cast<T*> ( segment.Data() ) ),
+          status ( reinterpret_cast<std::atomic<int64_t>*> ( segment.Data() + SequenceOffset() ) )
+    {
+        if ( create )
+        {
+            for ( int i = 0; i < N; i++ )
+            {
+                new ( &status[i] ) std::atomic<int64_t> ( i );
+            }
+            segment.Publish();
+        }
+    }
+
+    inline bool TryEnqueue ( const T& t )
+    {
+        int64_t current_head = header->head.load ( std::memory_order_relaxed );
+        while ( true )
+        {
+            int64_t diff = status[current_head & mask].load ( std::memory_order_acquire ) - current_head;
+            if ( diff == 0 )
+            {
+                if ( header->head.compare_exchange_weak ( current_head, current_head + 1, std::memory_order_relaxed ) )
+                {
+                    break;
+                }
+            }
+            else if ( diff < 0 )
+            {
+                return false;
+            }
+            else
+            {
+                current_head = header->head.load ( std::memory_order_relaxed );
+            }
+        }
+        buffer[current_head & mask] = t;
+        status[current_head & mask].store ( current_head + 1, std::memory_order_release );
+        header->waiter.Signal();
+        return true;
+    }
+
+    inline void Enqueue ( const T& t )
+    {
+        while ( !TryEnqueue ( t ) )
+        {
+            concurrent::CpuRelax();
+        }
+    }
+
+    template<class TFunc>
+    inline long Dequeue ( const TFunc& action )
+    {
+        int64_t start = header->tail.load ( std::memory_order_relaxed );
+        int64_t current_tail = start;
+        while ( status[current_tail & mask].load ( std::memory_order_acquire ) == current_tail + 1 )
+        {
+            action ( buffer[current_tail & mask] );
+            status[current_tail & mask].store ( current_tail + N, std::memory_order_release );
+            current_tail++;
+        }
+        if ( current_tail != start )
+        {
+            header->tail.store ( current_tail, std::memory_order_release );
+        }
+        return current_tail - start;
+    }
+
+    template<class TFunc>
+    inline bool DequeueWait ( const TFunc& action, int timeout )
+    {
+        auto ready = [this]
+        {
+            int64_t current_tail = header->tail.load ( std::memory_order_relaxed );
+            return status[current_tail & mask].load ( std::memory_order_acquire ) == current_tail + 1;
+        };
+        if ( !header->waiter.Wait ( ready, timeout ) )
+        {
+            return false;
+        }
+        Dequeue ( action );
+        return true;
+    }
+
+    inline int Size() const
+    {
+        return header->head.load ( std::memory_order_acquire ) - header->tail.load ( std::memory_order_acquire );
+    }
+
+    inline long Capacity() const
+    {
+        return N;
+    }
+
+    static bool Remove ( const std::string& name )
+    {
+        return impl::SharedRingSegment::Remove ( name );
+    }
+
+private:
+    static constexpr std::size_t SequenceOffset()
+    {
+        return ( sizeof ( T ) * N + impl::cacheline_size - 1 ) / impl::cacheline_size * impl::cacheline_size;
+    }
+
+    impl::SharedRingSegment segment;
+    impl::SharedRingHeader* header;
+    T* buffer;
+    std::atomic<int64_t>* status;
+    int64_t mask = N - 1;
+};
+}
+}
+
+#endif //LIBTRADE_SHARED_CONTAINER_H
@@ -0,0 +1,485 @@
+#include "simd.h"
+
+#include <algorithm>
+#include <limits>
+
+#if ( defined(__x86_64__) || defined(_M_X64) ) && ( defined(__GNUC__) || defined(__clang__) )
+#define LIBTRADE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace trade
+{
+namespace simd
+{
+namespace
+{
+template<class T>
+T SumScalar ( const T* data, long n )
+{
+    T total = 0;
+    for ( long i = 0; i < n; i++ )
+    {
+        total += data[i];
+    }
+    return total;
+}
+
+template<class T>
+T MinScalar ( const T* data, long n )
+{
+    T result = std::numeric_limits<T>::max();
+    for ( long i = 0; i < n; i++ )
+    {
+        result = data[i] < result ? data[i] : result;
+    }
+    return result;
+}
+
+template<class T>
+T MaxScalar ( const T* data, long n )
+{
+    T result = std::numeric_limits<T>::lowest();
+    for ( long i = 0; i < n; i++ )
+    {
+        result = data[i] > result ? data[i] : result;
+    }
+    return result;
+}
+
+template<class T>
+long CountGreaterScalar ( const T* data, long n, T threshold )
+{
+    long count = 0;
+    for ( long i = 0; i < n; i++ )
+    {
+        count += data[i] > threshold;
+    }
+    return count;
+}
+
+template<class T>
+long FilterGreaterScalar ( const T* data, long n, T threshold, long* indices, long base )
+{
+    long count = 0;
+    for ( long i = 0; i < n; i++ )
+    {
+        indices[count] = base + i;
+        count += data[i] > threshold;
+    }
+    return count;
+}
+
+#if defined(LIBTRADE_SIMD_X86)
+static_assert ( sizeof ( long ) == sizeof ( int64_t ), "the index kernels store longs as 64 bit lanes" );
+
+#define LIBTRADE_AVX2 __attribute__ ( ( target ( "avx2" ) ) )
+#define LIBTRADE_AVX512 __attribute__ ( ( target ( "avx512f" ) ) )
+
+//---------------------------------------------------------------- avx2
+
+LIBTRADE_AVX2 double SumAvx2 ( const double* data, long n )
+{
+    __m256d a0 = _mm256_setzero_pd();
+    __m256d a1 = _mm256_setzero_pd();
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        a0 = _mm256_add_pd ( a0, _mm256_loadu_pd ( data + i ) );
+        a1 = _mm256_add_pd ( a1, _mm256_loadu_pd ( data + i + 4 ) );
+    }
+    a0 = _mm256_add_pd ( a0, a1 );
+    __m128d half = _mm_add_pd ( _mm256_castpd256_pd128 ( a0 ), _mm256_extractf128_pd ( a0, 1 ) );
+    double total = _mm_cvtsd_f64 ( _mm_add_sd ( half, _mm_unpackhi_pd ( half, half ) ) );
+    return total + SumScalar ( data + i, n - i );
+}
+
+LIBTRADE_AVX2 double MinAvx2 ( const double* data, long n )
+{
+    __m256d acc = _mm256_set1_pd ( std::numeric_limits<double>::max() );
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        acc = _mm256_min_pd ( acc, _mm256_loadu_pd ( data + i ) );
+    }
+    alignas ( 32 ) double lanes[4];
+    _mm256_store_pd ( lanes, acc );
+    return std::min ( std::min ( std::min ( lanes[0], lanes[1] ), std::min ( lanes[2], lanes[3] ) ),
+                      MinScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX2 double MaxAvx2 ( const double* data, long n )
+{
+    __m256d acc = _mm256_set1_pd ( std::numeric_limits<double>::lowest() );
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        acc = _mm256_max_pd ( acc, _mm256_loadu_pd ( data + i ) );
+    }
+    alignas ( 32 ) double lanes[4];
+    _mm256_store_pd ( lanes, acc );
+    return std::max ( std::max ( std::max ( lanes[0], lanes[1] ), std::max ( lanes[2], lanes[3] ) ),
+                      MaxScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX2 long CountGreaterAvx2 ( const double* data, long n, double threshold )
+{
+    __m256d t = _mm256_set1_pd ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        count += __builtin_popcount ( _mm256_movemask_pd ( _mm256_cmp_pd ( _mm256_loadu_pd ( data + i ), t, _CMP_GT_OQ ) ) );
+    }
+    return count + CountGreaterScalar ( data + i, n - i, threshold );
+}
+
+LIBTRADE_AVX2 long FilterGreaterAvx2 ( const double* data, long n, double threshold, long* indices, long base )
+{
+    __m256d t = _mm256_set1_pd ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        unsigned mask = _mm256_movemask_pd ( _mm256_cmp_pd ( _mm256_loadu_pd ( data + i ), t, _CMP_GT_OQ ) );
+        while ( mask != 0 )
+        {
+            indices[count++] = base + i + __builtin_ctz ( mask );
+            mask &= mask - 1;
+        }
+    }
+    return count + FilterGreaterScalar ( data + i, n - i, threshold, indices + count, base + i );
+}
+
+LIBTRADE_AVX2 int64_t SumAvx2 ( const int64_t* data, long n )
+{
+    __m256i a0 = _mm256_setzero_si256();
+    __m256i a1 = _mm256_setzero_si256();
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        a0 = _mm256_add_epi64 ( a0, _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i ) ) );
+        a1 = _mm256_add_epi64 ( a1, _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i + 4 ) ) );
+    }
+    alignas ( 32 ) int64_t lanes[4];
+    _mm256_store_si256 ( reinterpret_cast<__m256i*> ( lanes ), _mm256_add_epi64 ( a0, a1 ) );
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumScalar ( data + i, n - i );
+}
+
+LIBTRADE_AVX2 int64_t MinAvx2 ( const int64_t* data, long n )
+{
+    __m256i acc = _mm256_set1_epi64x ( std::numeric_limits<int64_t>::max() );
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        __m256i v = _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i ) );
+        acc = _mm256_blendv_epi8 ( acc, v, _mm256_cmpgt_epi64 ( acc, v ) );
+    }
+    alignas ( 32 ) int64_t lanes[4];
+    _mm256_store_si256 ( reinterpret_cast<__m256i*> ( lanes ), acc );
+    return std::min ( std::min ( std::min ( lanes[0], lanes[1] ), std::min ( lanes[2], lanes[3] ) ),
+                      MinScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX2 int64_t MaxAvx2 ( const int64_t* data, long n )
+{
+    __m256i acc = _mm256_set1_epi64x ( std::numeric_limits<int64_t>::lowest() );
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        __m256i v = _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i ) );
+        acc = _mm256_blendv_epi8 ( acc, v, _mm256_cmpgt_epi64 ( v, acc ) );
+    }
+    alignas ( 32 ) int64_t lanes[4];
+    _mm256_store_si256 ( reinterpret_cast<__m256i*> ( lanes ), acc );
+    return std::max ( std::max ( std::max ( lanes[0], lanes[1] ), std::max ( lanes[2], lanes[3] ) ),
+                      MaxScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX2 long CountGreaterAvx2 ( const int64_t* data, long n, int64_t threshold )
+{
+    __m256i t = _mm256_set1_epi64x ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        __m256i v = _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i ) );
+        count += __builtin_popcount ( _mm256_movemask_pd ( _mm256_castsi256_pd ( _mm256_cmpgt_epi64 ( v, t ) ) ) );
+    }
+    return count + CountGreaterScalar ( data + i, n - i, threshold );
+}
+
+LIBTRADE_AVX2 long FilterGreaterAvx2 ( const int64_t* data, long n, int64_t threshold, long* indices, long base )
+{
+    __m256i t = _mm256_set1_epi64x ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+    {
+        __m256i v = _mm256_loadu_si256 ( reinterpret_cast<const __m256i*> ( data + i ) );
+        unsigned mask = _mm256_movemask_pd ( _mm256_castsi256_pd ( _mm256_cmpgt_epi64 ( v, t ) ) );
+        while ( mask != 0 )
+        {
+            indices[count++] = base + i + __builtin_ctz ( mask );
+            mask &= mask - 1;
+        }
+    }
+    return count + FilterGreaterScalar ( data + i, n - i, threshold, indices + count, base + i );
+}
+
+//---------------------------------------------------------------- avx512
+
+LIBTRADE_AVX512 double SumAvx512 ( const double* data, long n )
+{
+    __m512d a0 = _mm512_setzero_pd();
+    __m512d a1 = _mm512_setzero_pd();
+    long i = 0;
+    for ( ; i + 16 <= n; i += 16 )
+    {
+        a0 = _mm512_add_pd ( a0, _mm512_loadu_pd ( data + i ) );
+        a1 = _mm512_add_pd ( a1, _mm512_loadu_pd ( data + i + 8 ) );
+    }
+    return _mm512_reduce_add_pd ( _mm512_add_pd ( a0, a1 ) ) + SumScalar ( data + i, n - i );
+}
+
+LIBTRADE_AVX512 double MinAvx512 ( const double* data, long n )
+{
+    __m512d acc = _mm512_set1_pd ( std::numeric_limits<double>::max() );
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        acc = _mm512_min_pd ( acc, _mm512_loadu_pd ( data + i ) );
+    }
+    return std::min ( _mm512_reduce_min_pd ( acc ), MinScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX512 double MaxAvx512 ( const double* data, long n )
+{
+    __m512d acc = _mm512_set1_pd ( std::numeric_limits<double>::lowest() );
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        acc = _mm512_max_pd ( acc, _mm512_loadu_pd ( data + i ) );
+    }
+    return std::max ( _mm512_reduce_max_pd ( acc ), MaxScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX512 long CountGreaterAvx512 ( const double* data, long n, double threshold )
+{
+    __m512d t = _mm512_set1_pd ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        count += __builtin_popcount ( _mm512_cmp_pd_mask ( _mm512_loadu_pd ( data + i ), t, _CMP_GT_OQ ) );
+    }
+    return count + CountGreaterScalar ( data + i, n - i, threshold );
+}
+
+LIBTRADE_AVX512 long FilterGreaterAvx512 ( const double* data, long n, double threshold, long* indices, long base )
+{
+    __m512d t = _mm512_set1_pd ( threshold );
+    __m512i lane = _mm512_set_epi64 ( 7, 6, 5, 4, 3, 2, 1, 0 );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        __mmask8 mask = _mm512_cmp_pd_mask ( _mm512_loadu_pd ( data + i ), t, _CMP_GT_OQ );
+        _mm512_mask_compressstoreu_epi64 ( indices + count, mask, _mm512_add_epi64 ( lane, _mm512_set1_epi64 ( base + i ) ) );
+        count += __builtin_popcount ( mask );
+    }
+    return count + FilterGreaterScalar ( data + i, n - i, threshold, indices + count, base + i );
+}
+
+LIBTRADE_AVX512 int64_t SumAvx512 ( const int64_t* data, long n )
+{
+    __m512i a0 = _mm512_setzero_si512();
+    __m512i a1 = _mm512_setzero_si512();
+    long i = 0;
+    for ( ; i + 16 <= n; i += 16 )
+    {
+        a0 = _mm512_add_epi64 ( a0, _mm512_loadu_si512 ( data + i ) );
+        a1 = _mm512_add_epi64 ( a1, _mm512_loadu_si512 ( data + i + 8 ) );
+    }
+    return _mm512_reduce_add_epi64 ( _mm512_add_epi64 ( a0, a1 ) ) + SumScalar ( data + i, n - i );
+}
+
+LIBTRADE_AVX512 int64_t MinAvx512 ( const int64_t* data, long n )
+{
+    __m512i acc = _mm512_set1_epi64 ( std::numeric_limits<int64_t>::max() );
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        acc = _mm512_min_epi64 ( acc, _mm512_loadu_si512 ( data + i ) );
+    }
+    return std::min ( static_cast<int64_t> ( _mm512_reduce_min_epi64 ( acc ) ), MinScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX512 int64_t MaxAvx512 ( const int64_t* data, long n )
+{
+    __m512i acc = _mm512_set1_epi64 ( std::numeric_limits<int64_t>::lowest() );
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        acc = _mm512_max_epi64 ( acc, _mm512_loadu_si512 ( data + i ) );
+    }
+    return std::max ( static_cast<int64_t> ( _mm512_reduce_max_epi64 ( acc ) ), MaxScalar ( data + i, n - i ) );
+}
+
+LIBTRADE_AVX512 long CountGreaterAvx512 ( const int64_t* data, long n, int64_t threshold )
+{
+    __m512i t = _mm512_set1_epi64 ( threshold );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        count += __builtin_popcount ( _mm512_cmpgt_epi64_mask ( _mm512_loadu_si512 ( data + i ), t ) );
+    }
+    return count + CountGreaterScalar ( data + i, n - i, threshold );
+}
+
+LIBTRADE_AVX512 long FilterGreaterAvx512 ( const int64_t* data, long n, int64_t threshold, long* indices, long base )
+{
+    __m512i t = _mm512_set1_epi64 ( threshold );
+    __m512i lane = _mm512_set_epi64 ( 7, 6, 5, 4, 3, 2, 1, 0 );
+    long count = 0;
+    long i = 0;
+    for ( ; i + 8 <= n; i += 8 )
+    {
+        __mmask8 mask = _mm512_cmpgt_epi64_mask ( _mm512_loadu_si512 ( data + i ), t );
+        _mm512_mask_compressstoreu_epi64 ( indices + count, mask, _mm512_add_epi64 ( lane, _mm512_set1_epi64 ( base + i ) ) );
+        count += __builtin_popcount ( mask );
+    }
+    return count + FilterGreaterScalar ( data + i, n - i, threshold, indices + count, base + i );
+}
+#endif
+
+struct Kernels
+{
+    double ( *sum_f64 ) ( const double*, long );
+    double ( *min_f64 ) ( const double*, long );
+    double ( *max_f64 ) ( const double*, long );
+    long ( *count_greater_f64 ) ( const double*, long, double );
+    long ( *filter_greater_f64 ) ( const double*, long, double, long*, long );
+    int64_t ( *sum_i64 ) ( const int64_t*, long );
+    int64_t ( *min_i64 ) ( const int64_t*, long );
+    int64_t ( *max_i64 ) ( const int64_t*, long );
+    long ( *count_greater_i64 ) ( const int64_t*, long, int64_t );
+    long ( *filter_greater_i64 ) ( const int64_t*, long, int64_t, long*, long );
+};
+
+Kernels Select ( Level level )
+{
+#if defined(LIBTRADE_SIMD_X86)
+    if ( level == Level::Avx512 )
+    {
+        return Kernels { SumAvx512, MinAvx512, MaxAvx512, CountGreaterAvx512, FilterGreaterAvx512,
+                         SumAvx512, MinAvx512, MaxAvx512, CountGreaterAvx512, FilterGreaterAvx512 };
+    }
+    if ( level == Level::Avx2 )
+    {
+        return Kernels { SumAvx2, MinAvx2, MaxAvx2, CountGreaterAvx2, FilterGreaterAvx2,
+                         SumAvx2, MinAvx2, MaxAvx2, CountGreaterAvx2, FilterGreaterAvx2 };
+    }
+#else
+    ( void ) level;
+#endif
+    return Kernels { SumScalar<double>, MinScalar<double>, MaxScalar<double>, CountGreaterScalar<double>,
+                     FilterGreaterScalar<double>, SumScalar<int64_t>, MinScalar<int64_t>, MaxScalar<int64_t>,
+                     CountGreaterScalar<int64_t>, FilterGreaterScalar<int64_t> };
+}
+
+struct Dispatch
+{
+    Level active;
+    Kernels kernels;
+};
+
+//chosen on first use rather than by a global initialiser, so that kernels called from other translation
+//units' static initialisers find it set up whatever order those run in
+Dispatch& Table()
+{
+    static Dispatch table { Detect(), Select ( Detect() ) };
+    return table;
+}
+}
+
+Level Detect()
+{
+#if defined(LIBTRADE_SIMD_X86)
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports ( "avx512f" ) )
+    {
+        return Level::Avx512;
+    }
+    if ( __builtin_cpu_supports ( "avx2" ) )
+    {
+        return Level::Avx2;
+    }
+#endif
+    return Level::Scalar;
+}
+
+Level Active()
+{
+    return Table().active;
+}
+
+void Use ( Level level )
+{
+    Dispatch& table = Table();
+    table.active = std::min ( level, Detect() );
+    table.kernels = Select ( table.active );
+}
+
+double Sum ( const double* data, long n )
+{
+    return Table().kernels.sum_f64 ( data, n );
+}
+
+double Min ( const double* data, long n )
+{
+    return Table().kernels.min_f64 ( data, n );
+}
+
+double Max ( const double* data, long n )
+{
+    return Table().kernels.max_f64 ( data, n );
+}
+
+long CountGreater ( const double* data, long n, double threshold )
+{
+    return Table().kernels.count_greater_f64 ( data, n, threshold );
+}
+
+long FilterGreater ( const double* data, long n, double threshold, long* indices, long base )
+{
+    return Table().kernels.filter_greater_f64 ( data, n, threshold, indices, base );
+}
+
+int64_t Sum ( const int64_t* data, long n )
+{
+    return Table().kernels.sum_i64 ( data, n );
+}
+
+int64_t Min ( const int64_t* data, long n )
+{
+    return Table().kernels.min_i64 ( data, n );
+}
+
+int64_t Max ( const int64_t* data, long n )
+{
+    return Table().kernels.max_i64 ( data, n );
+}
+
+long CountGreater ( const int64_t* data, long n, int64_t threshold )
+{
+    return Table().kernels.count_greater_i64 ( data, n, threshold );
+}
+
+long FilterGreater ( const int64_t* data, long n, int64_t threshold, long* indices, long base )
+{
+    return Table().kernels.filter_greater_i64 ( data, n, threshold, indices, base );
+}
+}
+}
@@ -0,0 +1,107 @@
+#ifndef LIBTRADE_SIMD_H
+#define LIBTRADE_SIMD_H
+
+#include <cstdint>
+
+namespace trade
+{
+namespace simd
+{
+//instruction set the kernels run with, picked from what the cpu supports on first use: the first kernel
+//call or Active(), so kernels may be called from static initialisers. Use() overrides it and must run
+//before the first kernel call
+enum class Level
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+Level Detect();
+Level Active();
+
+//run the kernels with level (capped at what Detect() returns), e.g. to compare against Scalar.
+//not thread safe, call before the first kernel call
+void Use ( Level level );
+
+//reductions and filters over contiguous arrays. Min/Max of nothing return the largest/lowest value of the
+//type, FilterGreater writes base + i for every data[i] > threshold into indices (room for n of them) and
+//returns their number
+double Sum ( const double* data, long n );
+double Min ( const double* data, long n );
+double Max ( const double* data, long n );
+long CountGreater ( const double* data, long n, double threshold );
+long FilterGreater ( const double* data, long n, double threshold, long* indices, long base = 0 );
+
+int64_t Sum ( const int64_t* data, long n );
+int64_t Min ( const int64_t* data, long n );
+int64_t Max ( const int64_t* data, long n );
+long CountGreater ( const int64_t* data, long n, int64_t threshold );
+long FilterGreater ( const int64_t* data, long n, int64_t threshold, long* indices, long base = 0 );
+
+//the same over the entries [first, last) of anything with Spans(first, last, action(const T*, long)),
+//i.e. SPSCRingBuffer, CircularArray and series::Column. the range is split where the ring wraps
+template<class TRing>
+inline typename TRing::value_type Sum ( const TRing& ring, long first, long last )
+{
+    typename TRing::value_type total = 0;
+    ring.Spans ( first, last, [&total] ( const typename TRing::value_type * data, long n )
+    {
+        total += Sum ( data, n );
+    } );
+    return total;
+}
+
+template<class TRing>
+inline typename TRing::value_type Min ( const TRing& ring, long first, long last )
+{
+    typename TRing::value_type result = Min ( static_cast<const typename TRing::value_type*> ( nullptr ), 0 );
+    ring.Spans ( first, last, [&result] ( const typename TRing::value_type * data, long n )
+    {
+        typename TRing::value_type value = Min ( data, n );
+        result = value < result ? value : result;
+    } );
+    return result;
+}
+
+template<class TRing>
+inline typename TRing::value_type Max ( const TRing& ring, long first, long last )
+{
+    typename TRing::value_type result = Max ( static_cast<const typename TRing::value_type*> ( nullptr ), 0 );
+    ring.Spans ( first, last, [&result] ( const typename TRing::value_type * data, long n )
+    {
+        typename TRing::value_type value = Max ( data, n );
+        result = value > result ? value : result;
+    } );
+    return result;
+}
+
+template<class TRing>
+inline long CountGreater ( const TRing& ring, long first, long last, typename TRing::value_type threshold )
+{
+    long count = 0;
+    ring.Spans ( first, last, [&count, threshold] ( const typename TRing::value_type * data, long n )
+    {
+        count += CountGreater ( data, n, threshold );
+    } );
+    return count;
+}
+
+//indices receives absolute ring indices and needs room for last - first of them
+template<class TRing>
+inline long FilterGreater ( const TRing& ring, long first, long last, typename TRing::value_type threshold,
+                            long* indices )
+{
+    long count = 0;
+    long base = first;
+    ring.Spans ( first, last, [&] ( const typename TRing::value_type * data, long n )
+    {
+        count += FilterGreater ( data, n, threshold, indices + count, base );
+        base += n;
+    } );
+    return count;
+}
+}
+}
+
+#endif //LIBTRADE_SIMD_H
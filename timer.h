@@ -0,0 +1,385 @@
+#ifndef LIBTRADE_TIMER_H
+#define LIBTRADE_TIMER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+#include "clock.h"
+
+namespace trade
+{
+namespace concurrent
+{
+//hierarchical hashed timer wheel: Levels wheels of 64 slots, level l covering 64^l ticks a slot. a timer goes
+//to the lowest level whose slot holds its expiry, and moves down a level each time the wheel enters that slot,
+//so scheduling, cancelling and expiring are O(1) and a tick with nothing due costs one bitmap test. timers live
+//in a free listed pool of nodes addressed by id, so schedule and cancel do not allocate once the pool has grown.
+//single threaded: schedule, cancel and advance from the thread driving it, usually from its polling loop
+template<class TAction = std::function<void()>>
+class TimerWheel
+{
+public:
+    //index and generation of the node, a stale id (fired or cancelled timer) never matches. 0 is no timer
+    typedef uint64_t TimerId;
+
+    static constexpr int Bits = 6;
+    static constexpr int Slots = 1 << Bits;
+    static constexpr int Levels = 6;
+
+    //resolution in nanoseconds a tick. timers fire on the first Advance at or after their deadline, the
+    //wheel spans 64^6 ticks (19 hours at 1us) and timers further out are parked and placed again when
+    //the wheel comes round
+    explicit TimerWheel ( int64_t resolution = 1000, int64_t now = TscClock::Now() )
+        : resolution ( resolution ), origin ( now )
+    {
+        std::fill ( heads, heads + Firing + 1, uint32_t ( Nil ) );
+        std::fill ( occupied, occupied + Levels + 1, 0 );
+    }
+
+    //deadline in nanoseconds on TscClock's time base
+    inline TimerId At ( int64_t deadline, TAction action )
+    {
+        return Schedule ( ToTick ( deadline ), 0, std::move ( action ) );
+    }
+
+    inline TimerId After ( std::chrono::nanoseconds delay, TAction action )
+    {
+        return At ( TscClock::Now() + delay.count(), std::move ( action ) );
+    }
+
+    //every period from now on, until cancelled. periods missed by a late Advance are skipped
+    inline TimerId Every ( std::chrono::nanoseconds period, TAction action )
+    {
+        int64_t ticks = std::max<int64_t> ( 1, ( period.count() + resolution - 1 ) / resolution );
+        return Schedule ( ToTick ( TscClock::Now() ) + ticks, ticks, std::move ( action ) );
+    }
+
+    //false if the timer already fired or was cancelled
+    inline bool Cancel ( TimerId id )
+    {
+        uint32_t index = static_cast<uint32_t> ( id );
+        if ( index >= nodes.size() || nodes[index].generation != static_cast<uint32_t> ( id >> 32 ) ||
+                nodes[index].slot == Detached )
+        {
+            return false;
+        }
+        Unlink ( index );
+        Free ( index );
+        return true;
+    }
+
+    //fire every timer due at now, returns how many fired. actions may schedule and cancel timers
+    inline int Advance ( int64_t now )
+    {
+        int64_t tick = now < origin ? -1 : ( now - origin ) / resolution;
+        int fired = 0;
+        if ( heads[Overdue] != Nil )
+        {
+            //fire the ones there now, those scheduled by their actions wait for the next Advance
+            for ( uint32_t index = heads[Overdue]; index != Nil; index = nodes[index].next )
+            {
+                nodes[index].slot = Firing;
+            }
+            heads[Firing] = heads[Overdue];
+            heads[Overdue] = Nil;
+            occupied[Levels] = 1ull << ( Firing % Slots );
+            fired += Expire ( Firing );
+        }
+        while ( current <= tick )
+        {
+            if ( count == 0 )
+            {
+                current = tick + 1;
+                break;
+            }
+            int64_t block_end = current | mask;
+            int64_t last = std::min ( tick, block_end );
+            uint64_t due = occupied[0] & ( ~0ull << ( current & mask ) ) & ( ~0ull >> ( mask - ( last & mask ) ) );
+            if ( due )
+            {
+                int64_t at = ( current & ~mask ) | __builtin_ctzll ( due );
+                current = at + 1;
+                fired += Expire ( static_cast<uint16_t> ( at & mask ) );
+                if ( ( current & mask ) == 0 )
+                {
+                    Cascade ( current );
+                }
+                continue;
+            }
+            if ( last < block_end )
+            {
+                current = last + 1;
+                break;
+            }
+            current = NextEvent ( block_end + 1, tick + 1 );
+            if ( ( current & mask ) == 0 )
+            {
+                Cascade ( current );
+            }
+        }
+        return fired;
+    }
+
+    inline int Poll()
+    {
+        return Advance ( TscClock::Now() );
+    }
+
+    //no timer fires before this (nanoseconds, INT64_MAX if there is none). exact for timers in the current
+    //64 ticks, the start of their slot for timers further out: sleep until then, Advance and ask again
+    inline int64_t NextDeadline() const
+    {
+        if ( count == 0 )
+        {
+            return INT64_MAX;
+        }
+        if ( heads[Overdue] != Nil )
+        {
+            return origin + ( current - 1 ) * resolution;
+        }
+        uint64_t due = occupied[0] & ( ~0ull << ( current & mask ) );
+        int64_t tick = due ? ( current & ~mask ) | __builtin_ctzll ( due ) : NextEvent ( ( current | mask ) + 1, INT64_MAX );
+        return tick == INT64_MAX ? INT64_MAX : origin + tick * resolution;
+    }
+
+    inline std::size_t Size() const
+    {
+        return count;
+    }
+
+    inline bool Empty() const
+    {
+        return count == 0;
+    }
+
+    inline int64_t Resolution() const
+    {
+        return resolution;
+    }
+
+private:
+    TimerWheel ( const TimerWheel& );
+    TimerWheel& operator= ( const TimerWheel& ); // non-copyable
+
+    static constexpr uint32_t Nil = ~0u;
+    static constexpr uint16_t Detached = 0xffff;
+    static constexpr uint16_t Overdue = Levels * Slots; // scheduled for a tick already expired
+    static constexpr uint16_t Firing = Overdue + 1;
+    static constexpr int64_t mask = Slots - 1;
+    static constexpr int64_t span = int64_t ( 1 ) << ( Bits * Levels );
+
+    struct Node
+    {
+        int64_t expiry = 0; // tick
+        int64_t period = 0; // ticks, 0 for one shot timers
+        uint32_t next = Nil;
+        uint32_t prev = Nil;
+        uint32_t generation = 1;
+        uint16_t slot = Detached; // level * Slots + slot while scheduled
+        TAction action;
+    };
+
+    //round up, a timer never fires early
+    inline int64_t ToTick ( int64_t deadline ) const
+    {
+        return deadline <= origin ? 0 : ( deadline - origin + resolution - 1 ) / resolution;
+    }
+
+    inline TimerId Schedule ( int64_t expiry, int64_t period, TAction&& action )
+    {
+        uint32_t index;
+        if ( free_head != Nil )
+        {
+            index = free_head;
+            free_head = nodes[index].next;
+        }
+        else
+        {
+            index = static_cast<uint32_t> ( nodes.size() );
+            nodes.emplace_back();
+        }
+        Node& node = nodes[index];
+        node.expiry = expiry;
+        node.period = period;
+        node.action = std::move ( action );
+        Place ( index );
+        count++;
+        return ( static_cast<TimerId> ( node.generation ) << 32 ) | index;
+    }
+
+    inline void Free ( uint32_t index )
+    {
+        Node& node = nodes[index];
+        if ( ++node.generation == 0 )
+        {
+            node.generation = 1;
+        }
+        node.slot = Detached;
+        node.next = free_head;
+        free_head = index;
+        count--;
+    }
+
+    //lowest level on which expiry and current differ only in that level's bits and below
+    inline void Place ( uint32_t index )
+    {
+        Node& node = nodes[index];
+        if ( node.expiry < current )
+        {
+            Link ( index, Overdue );
+            return;
+        }
+        int64_t expiry = node.expiry;
+        uint64_t delta = static_cast<uint64_t> ( expiry ^ current );
+        int level = 0;
+        while ( level < Levels - 1 && ( delta >> ( Bits * ( level + 1 ) ) ) != 0 )
+        {
+            level++;
+        }
+        int64_t slot;
+        if ( level == Levels - 1 && expiry - current >= span - ( int64_t ( 1 ) << ( Bits * level ) ) )
+        {
+            slot = ( ( current >> ( Bits * level ) ) - 1 ) & mask; // beyond the wheel: the slot reached last
+        }
+        else
+        {
+            slot = ( expiry >> ( Bits * level ) ) & mask;
+        }
+        Link ( index, static_cast<uint16_t> ( level * Slots + slot ) );
+    }
+
+    inline void Link ( uint32_t index, uint16_t slot )
+    {
+        Node& node = nodes[index];
+        node.slot = slot;
+        node.prev = Nil;
+        node.next = heads[slot];
+        if ( node.next != Nil )
+        {
+            nodes[node.next].prev = index;
+        }
+        heads[slot] = index;
+        occupied[slot / Slots] |= 1ull << ( slot % Slots );
+    }
+
+    inline void Unlink ( uint32_t index )
+    {
+        Node& node = nodes[index];
+        if ( node.prev != Nil )
+        {
+            nodes[node.prev].next = node.next;
+        }
+        else
+        {
+            heads[node.slot] = node.next;
+        }
+        if ( node.next != Nil )
+        {
+            nodes[node.next].prev = node.prev;
+        }
+        if ( heads[node.slot] == Nil )
+        {
+            occupied[node.slot / Slots] &= ~ ( 1ull << ( node.slot % Slots ) );
+        }
+        node.slot = Detached;
+    }
+
+    //fire every timer of slot, a level 0 slot current is already past or Firing, so that timers scheduled
+    //from the actions land elsewhere
+    inline int Expire ( uint16_t slot )
+    {
+        int fired = 0;
+        while ( heads[slot] != Nil )
+        {
+            uint32_t index = heads[slot];
+            Unlink ( index );
+            Node& node = nodes[index];
+            TAction action = std::move ( node.action );
+            if ( node.period > 0 )
+            {
+                node.expiry += node.period;
+                if ( node.expiry < current )
+                {
+                    node.expiry += ( ( current - node.expiry ) / node.period + 1 ) * node.period;
+                }
+                uint32_t generation = node.generation;
+                Place ( index );
+                action();
+                if ( nodes[index].generation == generation )
+                {
+                    nodes[index].action = std::move ( action );
+                }
+            }
+            else
+            {
+                Free ( index );
+                action();
+            }
+            fired++;
+        }
+        return fired;
+    }
+
+    //the wheel entered tick t: move the timers of every slot starting at t down, highest level first
+    inline void Cascade ( int64_t t )
+    {
+        for ( int level = Levels - 1; level > 0; level-- )
+        {
+            if ( ( t & ( ( int64_t ( 1 ) << ( Bits * level ) ) - 1 ) ) != 0 )
+            {
+                continue;
+            }
+            uint16_t slot = static_cast<uint16_t> ( level * Slots + ( ( t >> ( Bits * level ) ) & mask ) );
+            uint32_t index = heads[slot];
+            heads[slot] = Nil;
+            occupied[level] &= ~ ( 1ull << ( slot % Slots ) );
+            while ( index != Nil )
+            {
+                uint32_t next = nodes[index].next;
+                Place ( index );
+                index = next;
+            }
+        }
+    }
+
+    //level 0 is empty and t starts a level 0 lap: the first tick from t on at which a slot has to be cascaded,
+    //or limit if that is not before it. everything in between can be skipped
+    inline int64_t NextEvent ( int64_t t, int64_t limit ) const
+    {
+        for ( int level = 1; level < Levels && t < limit; level++ )
+        {
+            int shift = Bits * level;
+            int64_t lap = ( t >> shift ) & ~mask;
+            uint64_t ahead = occupied[level] & ( ~0ull << ( ( t >> shift ) & mask ) );
+            if ( ahead )
+            {
+                return std::min ( std::max ( t, ( lap | __builtin_ctzll ( ahead ) ) << shift ), limit );
+            }
+            if ( level == Levels - 1 )
+            {
+                //the top level wraps: what is left is in the next lap
+                return occupied[level] ? std::min ( ( ( lap + Slots ) | __builtin_ctzll ( occupied[level] ) ) << shift, limit ) : limit;
+            }
+            int64_t above = int64_t ( 1 ) << ( shift + Bits );
+            t = ( t + above - 1 ) & ~ ( above - 1 ); // the start of the next slot of the level above, t if it is one
+        }
+        return std::min ( t, limit );
+    }
+
+    int64_t resolution;
+    int64_t origin;
+    int64_t current = 0; // first tick not yet expired
+    std::size_t count = 0;
+    uint32_t heads[Levels * Slots + 2];
+    uint64_t occupied[Levels + 1];
+    std::deque<Node> nodes; // stable addresses, actions may schedule while one runs
+    uint32_t free_head = Nil;
+};
+}
+}
+
+#endif //LIBTRADE_TIMER_H